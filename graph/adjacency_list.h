@@ -1,5 +1,7 @@
 #pragma once
-#include <single_list.h>
+#include <algorithm>
+#include <vector>
+#include <assert.h>
 #include <debug_new.h>
 
 struct graph_traits {
@@ -8,81 +10,330 @@ struct graph_traits {
 
     struct unoriented {
     };
+
+    // adjacency lists that grow edge by edge
+    struct linked {
+    };
+
+    // compressed sparse row: offsets array plus one contiguous array
+    // of sorted neighbours, built in bulk from an edge list
+    struct csr {
+    };
+
+    // edge payload of graphs that store nothing but the endpoints
+    struct unweighted {
+    };
+};
+
+template<class Iterator>
+class TRange {
+public:
+    TRange(Iterator _first, Iterator _last) :
+        first( _first ),
+        last( _last )
+    {
+    }
+
+    Iterator begin() const { return first; }
+    Iterator end() const { return last; }
+    int size() const { return last - first; }
+    bool empty() const { return first == last; }
+
+private:
+    Iterator first;
+    Iterator last;
 };
 
-template<class Orientation=graph_traits::unoriented>
+// Edge payloads kept parallel to an array of neighbour ids.
+template<class EdgeValue>
+class TEdgeValueArray {
+public:
+    const EdgeValue* data() const { return values.data(); }
+    const EdgeValue& get(int pos) const { return values[pos]; }
+    void set(int pos, const EdgeValue& v) { values[pos] = v; }
+    void insert(int pos, const EdgeValue& v) { values.insert(values.begin() + pos, v); }
+    void resize(int n) { values.resize(n); }
+    void shrink_to_fit() { values.shrink_to_fit(); }
+
+private:
+    std::vector<EdgeValue> values;
+};
+
+// Unweighted graphs keep no payload at all.
+template<>
+class TEdgeValueArray<graph_traits::unweighted> {
+public:
+    graph_traits::unweighted get(int pos) const { return graph_traits::unweighted(); }
+    void set(int pos, const graph_traits::unweighted& v) {}
+    void insert(int pos, const graph_traits::unweighted& v) {}
+    void resize(int n) {}
+    void shrink_to_fit() {}
+};
+
+template<class Orientation=graph_traits::unoriented, class Storage=graph_traits::linked,
+         class EdgeValue=graph_traits::unweighted>
 class TAdjacencyListGraph {
 private:
-    typedef TSingleLinkedList<int> EdgeEndList;
-    typedef TSingleLinkedList<EdgeEndList> EdgeStartList;
-    typedef EdgeStartList::ForwardIterator EdgeStartIterator;
-    typedef EdgeEndList::ForwardIterator EdgeEndIterator;
+    // every vertex keeps its neighbours sorted, so duplicates are found
+    // with a binary search; unoriented edges are stored at both ends
+    typedef std::vector<int> EdgeEndList;
+    typedef std::vector<EdgeEndList> EdgeStartList;
+    typedef TEdgeValueArray<EdgeValue> EdgeValueList;
 
 public:
+    typedef Orientation OrientationType;
+    typedef EdgeValue EdgeValueType;
+    typedef EdgeEndList::const_iterator NeighbourIterator;
+    typedef TRange<NeighbourIterator> NeighbourRange;
+    typedef TRange<const EdgeValue*> EdgeValueRange;
+
     TAdjacencyListGraph(int _n_vertices) :
-        n_vertices( _n_vertices )
+        n_vertices( _n_vertices ),
+        n_edges( 0 ),
+        edge_list( _n_vertices ),
+        edge_values_list( _n_vertices )
     {
-        edge_list.reserve(n_vertices);
     }
 
     int vertices() const { return n_vertices; }
     int edges() const { return n_edges; }
 
-    bool add_edge(int i, int j) 
+    int degree(int i) const
+    {
+        assert(i < n_vertices);
+        return edge_list[i].size();
+    }
+
+    NeighbourRange neighbours(int i) const
+    {
+        assert(i < n_vertices);
+        return NeighbourRange(edge_list[i].begin(), edge_list[i].end());
+    }
+
+    // payloads of the edges leaving i, in the same order as neighbours(i)
+    EdgeValueRange edge_values(int i) const
+    {
+        assert(i < n_vertices);
+        return EdgeValueRange(edge_values_list[i].data(), edge_values_list[i].data() + edge_list[i].size());
+    }
+
+    bool has_edge(int i, int j) const
+    {
+        NeighbourRange r = neighbours(i);
+        return std::binary_search(r.begin(), r.end(), j);
+    }
+
+    // An edge that is already there keeps its old value.
+    bool add_edge(int i, int j, const EdgeValue& value = EdgeValue()) 
     {
         assert(i < n_vertices);
         assert(j < n_vertices);
-        return add_edge(i, j, Orientation());
+        return add_edge(i, j, value, Orientation());
     }
 
 private:
     int n_vertices;
     int n_edges;
     EdgeStartList edge_list;
+    std::vector<EdgeValueList> edge_values_list;
 
-    bool add_edge(int i, int j, const graph_traits::oriented&) 
+    bool add_edge(int i, int j, const EdgeValue& value, const graph_traits::oriented&) 
     {
-        if (add_edge_internal(i, j)) {
+        if (add_edge_internal(i, j, value)) {
             ++n_edges;
             return true;
         }
         return false;
     }
 
-    bool add_edge(int i, int j, const graph_traits::unoriented&) 
+    bool add_edge(int i, int j, const EdgeValue& value, const graph_traits::unoriented&) 
     {
-        if (add_edge_internal(std::min(i, j), std::max(i, j))) {
+        if (add_edge_internal(i, j, value)) {
+            if (i != j) {
+                add_edge_internal(j, i, value);
+            }
             ++n_edges;
             return true;
         }
         return false;
     }
 
-    bool add_edge_internal(int i, int j) 
+    bool add_edge_internal(int i, int j, const EdgeValue& value) 
+    {
+        EdgeEndList& ends = edge_list[i];
+        EdgeEndList::iterator it = std::lower_bound(ends.begin(), ends.end(), j);
+        if (it != ends.end() && *it == j) {
+            return false;
+        }
+        edge_values_list[i].insert(it - ends.begin(), value);
+        ends.insert(it, j);
+        return true;
+    }
+};
+
+template<class Orientation, class EdgeValue>
+class TAdjacencyListGraph<Orientation, graph_traits::csr, EdgeValue> {
+public:
+    typedef Orientation OrientationType;
+    typedef EdgeValue EdgeValueType;
+    typedef const int* NeighbourIterator;
+    typedef TRange<NeighbourIterator> NeighbourRange;
+    typedef TRange<const EdgeValue*> EdgeValueRange;
+
+    TAdjacencyListGraph(int _n_vertices) :
+        n_vertices( _n_vertices ),
+        n_edges( 0 ),
+        offsets( _n_vertices + 1, 0 )
+    {
+    }
+
+    // Edges are taken from [first, last) as std::pair<int, int>; the range
+    // is walked twice, so it has to be a forward range. Duplicates are dropped.
+    template<class EdgeIterator>
+    TAdjacencyListGraph(int _n_vertices, EdgeIterator first, EdgeIterator last) :
+        n_vertices( _n_vertices ),
+        n_edges( 0 )
+    {
+        build(first, last);
+    }
+
+    // Same as above, with edge payloads read in step from values_first.
+    template<class EdgeIterator, class ValueIterator>
+    TAdjacencyListGraph(int _n_vertices, EdgeIterator first, EdgeIterator last, ValueIterator values_first) :
+        n_vertices( _n_vertices ),
+        n_edges( 0 )
+    {
+        build(first, last, values_first);
+    }
+
+    int vertices() const { return n_vertices; }
+    int edges() const { return n_edges; }
+
+    int degree(int i) const
+    {
+        assert(i < n_vertices);
+        return offsets[i + 1] - offsets[i];
+    }
+
+    NeighbourRange neighbours(int i) const
+    {
+        assert(i < n_vertices);
+        return NeighbourRange(targets.data() + offsets[i], targets.data() + offsets[i + 1]);
+    }
+
+    // payloads of the edges leaving i, in the same order as neighbours(i)
+    EdgeValueRange edge_values(int i) const
+    {
+        assert(i < n_vertices);
+        return EdgeValueRange(values.data() + offsets[i], values.data() + offsets[i + 1]);
+    }
+
+    bool has_edge(int i, int j) const
+    {
+        NeighbourRange r = neighbours(i);
+        return std::binary_search(r.begin(), r.end(), j);
+    }
+
+    template<class EdgeIterator>
+    void build(EdgeIterator first, EdgeIterator last)
+    {
+        build(first, last, DefaultValueIterator());
+    }
+
+    // When an edge is given more than once, its first value is kept.
+    template<class EdgeIterator, class ValueIterator>
+    void build(EdgeIterator first, EdgeIterator last, ValueIterator values_first)
     {
-        int ni = 0;
-        for (EdgeStartIterator it = edge_list.begin(); it != edge_list.end(); ++it, ++ni) {
-            if (ni < i) {
-                continue;
+        offsets.assign(n_vertices + 1, 0);
+        for (EdgeIterator it = first; it != last; ++it) {
+            assert(it->first < n_vertices);
+            assert(it->second < n_vertices);
+            ++offsets[it->first + 1];
+            if (!is_oriented(Orientation()) && it->first != it->second) {
+                ++offsets[it->second + 1];
             }
-            assert (ni == i);
-            bool inserted = false;
-            for (EdgeEndIterator it2 = it->begin(); it2 != it->end(); ++it2) {
-                if (*it2 == j) {
-                    return false;
-                } else if (*it2 > j) {
-                    it->insert(it2, j);
-                    inserted = true;
-                    assert(*it2 == j);
-                    break;
-                }
+        }
+        for (int i = 0; i < n_vertices; ++i) {
+            offsets[i + 1] += offsets[i];
+        }
+
+        targets.resize(offsets[n_vertices]);
+        values.resize(offsets[n_vertices]);
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        ValueIterator vit = values_first;
+        for (EdgeIterator it = first; it != last; ++it, ++vit) {
+            values.set(fill[it->first], *vit);
+            targets[fill[it->first]++] = it->second;
+            if (!is_oriented(Orientation()) && it->first != it->second) {
+                values.set(fill[it->second], *vit);
+                targets[fill[it->second]++] = it->first;
             }
-            if (!inserted) {
-                it->push_back(j);
+        }
+
+        // sort every row and squeeze out duplicates, compacting in place
+        int out = 0, self_loops = 0;
+        int row_begin = 0;
+        for (int i = 0; i < n_vertices; ++i) {
+            int row_end = offsets[i + 1];
+            sort_row(row_begin, row_end, EdgeValue());
+            offsets[i] = out;
+            for (int k = row_begin; k < row_end; ++k) {
+                if (out == offsets[i] || targets[out - 1] != targets[k]) {
+                    if (targets[k] == i) {
+                        ++self_loops;
+                    }
+                    values.set(out, values.get(k));
+                    targets[out++] = targets[k];
+                }
             }
-            return true;
+            row_begin = row_end;
+        }
+        offsets[n_vertices] = out;
+        targets.resize(out);
+        targets.shrink_to_fit();
+        values.resize(out);
+        values.shrink_to_fit();
+
+        n_edges = is_oriented(Orientation()) ? out : (out + self_loops) / 2;
+    }
+
+private:
+    int n_vertices;
+    int n_edges;
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    TEdgeValueArray<EdgeValue> values;
+
+    struct DefaultValueIterator {
+        EdgeValue operator*() const { return EdgeValue(); }
+        DefaultValueIterator& operator++() { return *this; }
+    };
+
+    static bool is_oriented(const graph_traits::oriented&) { return true; }
+    static bool is_oriented(const graph_traits::unoriented&) { return false; }
+
+    void sort_row(int row_begin, int row_end, const graph_traits::unweighted&)
+    {
+        std::sort(targets.begin() + row_begin, targets.begin() + row_end);
+    }
+
+    template<class Value>
+    void sort_row(int row_begin, int row_end, const Value&)
+    {
+        // stable, so that the first of several equal edges keeps its value
+        if (row_end - row_begin < 2) {
+            return;
+        }
+        std::vector<std::pair<int, Value>> row;
+        row.reserve(row_end - row_begin);
+        for (int k = row_begin; k < row_end; ++k) {
+            row.push_back(std::make_pair(targets[k], values.get(k)));
+        }
+        std::stable_sort(row.begin(), row.end(),
+            [] (const std::pair<int, Value>& a, const std::pair<int, Value>& b) { return a.first < b.first; });
+        for (int k = row_begin; k < row_end; ++k) {
+            targets[k] = row[k - row_begin].first;
+            values.set(k, row[k - row_begin].second);
         }
-        assert(false);
-        return true;
     }
 };
@@ -0,0 +1,147 @@
+#pragma once
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <bool_array.h>
+#include "adjacency_list.h"
+
+namespace Nstd {
+
+// Runs f(thread_index) on n_threads threads, the calling thread included,
+// and waits for all of them.
+template<class Func>
+void run_parallel(int n_threads, Func f)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads - 1);
+    for (int t = 1; t < n_threads; ++t) {
+        threads.push_back(std::thread(f, t));
+    }
+    f(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Direction-optimizing BFS (Beamer et al.): a level is expanded top-down
+// (frontier pushes to its neighbours) while the frontier is small, and
+// bottom-up (unvisited vertices look for a parent in the frontier) while
+// it is large. Frontiers are bool_array bitmaps; each thread marks the
+// vertices it discovers in its own bitmap, and the bitmaps are combined
+// with merge_or. Vertex ranges are split on byte boundaries, so threads
+// never write the same byte of a shared bitmap.
+//
+// On return depth[v] is the BFS level of v, or -1 if v is unreachable.
+// Returns the number of edges inspected.
+template<class Graph>
+long long parallel_breadth_first_search(const Graph& graph, int source, std::vector<int>& depth,
+                                        int n_threads, bool direction_optimizing = true)
+{
+    static_assert(std::is_same<typename Graph::OrientationType, graph_traits::unoriented>::value,
+                  "bottom-up steps need in-neighbours, use an unoriented graph");
+    const int alpha = 14;
+    const int beta = 24;
+
+    int n = graph.vertices();
+    assert(source < n);
+    assert(n_threads > 0);
+    depth.assign(n, -1);
+
+    nvwa::bool_array frontier(n), next(n), visited(n);
+    frontier.initialize(false);
+    visited.initialize(false);
+    std::vector<nvwa::bool_array> discovered(n_threads, nvwa::bool_array(n));
+    std::vector<long long> inspected(n_threads, 0), frontier_edges(n_threads, 0);
+    std::vector<int> frontier_vertices(n_threads, 0);
+
+    int chunk = ((n + n_threads - 1) / n_threads + 7) & ~7;
+    auto range_begin = [chunk, n] (int t) { return std::min(n, t * chunk); };
+    auto range_end = [chunk, n] (int t) { return std::min(n, (t + 1) * chunk); };
+
+    frontier[source] = visited[source] = true;
+    depth[source] = 0;
+    long long unexplored_edges = 0;
+    for (int v = 0; v < n; ++v) {
+        unexplored_edges += graph.degree(v);
+    }
+    long long n_frontier_edges = graph.degree(source);
+    unexplored_edges -= n_frontier_edges;
+    int n_frontier = 1;
+    bool bottom_up = false;
+
+    for (int level = 1; n_frontier > 0; ++level) {
+        if (direction_optimizing) {
+            if (!bottom_up && n_frontier_edges > unexplored_edges / alpha) {
+                bottom_up = true;
+            } else if (bottom_up && n_frontier < n / beta) {
+                bottom_up = false;
+            }
+        }
+
+        run_parallel(n_threads, [&] (int t) {
+            nvwa::bool_array& mine = discovered[t];
+            mine.initialize(false);
+            size_t lo = range_begin(t), hi = range_end(t);
+            long long edges_seen = 0;
+            if (bottom_up) {
+                for (size_t v = visited.find_until(false, lo, hi); v != nvwa::bool_array::npos; v = visited.find_until(false, v + 1, hi)) {
+                    for (int u : graph.neighbours(v)) {
+                        ++edges_seen;
+                        if (frontier[u]) {
+                            mine[v] = true;
+                            break;
+                        }
+                    }
+                }
+            } else {
+                for (size_t v = frontier.find_until(true, lo, hi); v != nvwa::bool_array::npos; v = frontier.find_until(true, v + 1, hi)) {
+                    for (int u : graph.neighbours(v)) {
+                        ++edges_seen;
+                        if (!visited[u]) {
+                            mine[u] = true;
+                        }
+                    }
+                }
+            }
+            inspected[t] += edges_seen;
+        });
+
+        next.initialize(false);
+        run_parallel(n_threads, [&] (int t) {
+            size_t lo = range_begin(t), hi = range_end(t);
+            int vertices_found = 0;
+            long long edges_found = 0;
+            if (lo < hi) {
+                for (int s = 0; s < n_threads; ++s) {
+                    next.merge_or(discovered[s], lo, hi, lo);
+                }
+                visited.merge_or(next, lo, hi, lo);
+            }
+            for (size_t v = next.find_until(true, lo, hi); v != nvwa::bool_array::npos; v = next.find_until(true, v + 1, hi)) {
+                depth[v] = level;
+                ++vertices_found;
+                edges_found += graph.degree(v);
+            }
+            frontier_vertices[t] = vertices_found;
+            frontier_edges[t] = edges_found;
+        });
+
+        frontier.swap(next);
+        n_frontier = 0;
+        n_frontier_edges = 0;
+        for (int t = 0; t < n_threads; ++t) {
+            n_frontier += frontier_vertices[t];
+            n_frontier_edges += frontier_edges[t];
+        }
+        unexplored_edges -= n_frontier_edges;
+    }
+
+    long long total = 0;
+    for (int t = 0; t < n_threads; ++t) {
+        total += inspected[t];
+    }
+    return total;
+}
+
+}
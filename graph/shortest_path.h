@@ -0,0 +1,162 @@
+#pragma once
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "adjacency_list.h"
+
+// Min-heap of the ids 0..n-1 ordered by a key, with decrease-key. Every
+// entry holds its key next to its id in one contiguous array, so sifting
+// compares keys without chasing into a separate distance table; position
+// maps an id to its slot. Children of slot k are Arity * k + 1 .. Arity * k + Arity.
+template<class Key, int Arity=4>
+class TIndexedHeap {
+public:
+    TIndexedHeap(int n) :
+        position( n, -1 )
+    {
+        heap.reserve(n);
+    }
+
+    bool empty() const { return heap.empty(); }
+    int size() const { return heap.size(); }
+    bool contains(int id) const { return position[id] >= 0; }
+
+    int top() const
+    {
+        assert(!empty());
+        return heap[0].second;
+    }
+
+    const Key& top_key() const
+    {
+        assert(!empty());
+        return heap[0].first;
+    }
+
+    void push(int id, const Key& key)
+    {
+        assert(!contains(id));
+        heap.push_back(std::make_pair(key, id));
+        position[id] = heap.size() - 1;
+        sift_up(heap.size() - 1);
+    }
+
+    int pop()
+    {
+        assert(!empty());
+        int id = heap[0].second;
+        position[id] = -1;
+        if (heap.size() > 1) {
+            heap[0] = heap.back();
+            position[heap[0].second] = 0;
+            heap.pop_back();
+            sift_down(0);
+        } else {
+            heap.pop_back();
+        }
+        return id;
+    }
+
+    void decrease_key(int id, const Key& key)
+    {
+        assert(contains(id));
+        assert(!(heap[position[id]].first < key));
+        heap[position[id]].first = key;
+        sift_up(position[id]);
+    }
+
+private:
+    std::vector<std::pair<Key, int>> heap;
+    std::vector<int> position;
+
+    void sift_up(int pos)
+    {
+        std::pair<Key, int> entry = heap[pos];
+        while (pos > 0) {
+            int parent = (pos - 1) / Arity;
+            if (!(entry.first < heap[parent].first)) {
+                break;
+            }
+            heap[pos] = heap[parent];
+            position[heap[pos].second] = pos;
+            pos = parent;
+        }
+        heap[pos] = entry;
+        position[entry.second] = pos;
+    }
+
+    void sift_down(int pos)
+    {
+        std::pair<Key, int> entry = heap[pos];
+        int n = heap.size();
+        while (true) {
+            int first_child = Arity * pos + 1;
+            if (first_child >= n) {
+                break;
+            }
+            int last_child = std::min(first_child + Arity, n);
+            int best = first_child;
+            for (int c = first_child + 1; c < last_child; ++c) {
+                if (heap[c].first < heap[best].first) {
+                    best = c;
+                }
+            }
+            if (!(heap[best].first < entry.first)) {
+                break;
+            }
+            heap[pos] = heap[best];
+            position[heap[pos].second] = pos;
+            pos = best;
+        }
+        heap[pos] = entry;
+        position[entry.second] = pos;
+    }
+};
+
+namespace Nstd {
+
+// Single-source shortest paths over non-negative edge values. On return
+// distance[v] is the length of the shortest path from source to v, or
+// std::numeric_limits<EdgeValueType>::max() if v is unreachable. The heap
+// is left empty, so it can be passed again for the next query.
+template<class Graph, class Heap>
+void dijkstra(const Graph& graph, int source, std::vector<typename Graph::EdgeValueType>& distance, Heap& heap)
+{
+    typedef typename Graph::EdgeValueType Weight;
+    static_assert(!std::is_same<Weight, graph_traits::unweighted>::value,
+                  "shortest paths need edge values");
+    assert(source < graph.vertices());
+    assert(heap.empty());
+
+    distance.assign(graph.vertices(), std::numeric_limits<Weight>::max());
+    distance[source] = Weight();
+    heap.push(source, distance[source]);
+    while (!heap.empty()) {
+        int v = heap.pop();
+        const Weight d = distance[v];
+        const Weight* w = graph.edge_values(v).begin();
+        for (int u : graph.neighbours(v)) {
+            assert(!(*w < Weight()));
+            Weight candidate = d + *w++;
+            if (candidate < distance[u]) {
+                distance[u] = candidate;
+                if (heap.contains(u)) {
+                    heap.decrease_key(u, candidate);
+                } else {
+                    heap.push(u, candidate);
+                }
+            }
+        }
+    }
+}
+
+template<int Arity, class Graph>
+void dijkstra(const Graph& graph, int source, std::vector<typename Graph::EdgeValueType>& distance)
+{
+    TIndexedHeap<typename Graph::EdgeValueType, Arity> heap(graph.vertices());
+    dijkstra(graph, source, distance, heap);
+}
+
+}
@@ -1,5 +1,16 @@
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <measure.h>
 #include "adjacency_list.h"
+#include "traversal.h"
+#include "parallel_bfs.h"
+#include "shortest_path.h"
+
+typedef std::vector<std::pair<int, int>> EdgeVector;
 
 void test_adj_list_basic()
 {
@@ -15,6 +26,49 @@ void test_adj_list_basic()
     assert(!gr2.add_edge(0, 1));
     assert(gr2.add_edge(1, 0));
     assert(!gr2.add_edge(1, 0));
+
+    assert(gr1.add_edge(3, 0));
+    assert(gr1.add_edge(2, 2));
+    assert(gr1.edges() == 3);
+    assert(gr1.degree(0) == 2);
+    assert(gr1.degree(2) == 1);
+    assert(gr1.has_edge(0, 3));
+    assert(gr1.has_edge(1, 0));
+    std::vector<int> n0(gr1.neighbours(0).begin(), gr1.neighbours(0).end());
+    assert(n0 == std::vector<int>({1, 3}));
+    assert(gr2.edges() == 2);
+    assert(gr2.degree(4) == 0);
+}
+
+void test_csr_basic()
+{
+    EdgeVector edges({ {0, 1}, {1, 0}, {0, 1}, {3, 1}, {2, 2}, {1, 4} });
+
+    TAdjacencyListGraph<graph_traits::unoriented, graph_traits::csr> gr1(5, edges.begin(), edges.end());
+    assert(gr1.vertices() == 5);
+    assert(gr1.edges() == 4);
+    assert(gr1.degree(0) == 1);
+    assert(gr1.degree(1) == 3);
+    assert(gr1.degree(2) == 1);
+    assert(gr1.degree(4) == 1);
+    std::vector<int> n1(gr1.neighbours(1).begin(), gr1.neighbours(1).end());
+    assert(n1 == std::vector<int>({0, 3, 4}));
+    assert(gr1.has_edge(4, 1));
+    assert(gr1.has_edge(2, 2));
+    assert(!gr1.has_edge(0, 4));
+
+    TAdjacencyListGraph<graph_traits::oriented, graph_traits::csr> gr2(5, edges.begin(), edges.end());
+    assert(gr2.edges() == 5);
+    assert(gr2.degree(0) == 1);
+    assert(gr2.degree(1) == 2);
+    assert(gr2.degree(4) == 0);
+    assert(gr2.neighbours(4).empty());
+    assert(gr2.has_edge(3, 1));
+    assert(!gr2.has_edge(1, 3));
+
+    TAdjacencyListGraph<graph_traits::oriented, graph_traits::csr> gr3(3);
+    assert(gr3.edges() == 0);
+    assert(gr3.degree(2) == 0);
 }
 
 void create_clique_graph_unoriented(int n_vertices, int& edges)
@@ -39,6 +93,48 @@ void create_clique_graph_oriented(int n_vertices, int& edges)
     edges = graph.edges();
 }
 
+template<class Graph>
+void fill_random_graph(Graph& graph, int n_edges)
+{
+    for(int k = 0; k < n_edges; ++k) {
+        graph.add_edge(rand() % graph.vertices(), rand() % graph.vertices());
+    }
+}
+
+EdgeVector random_edges(int n_vertices, int n_edges)
+{
+    EdgeVector edge_list;
+    edge_list.reserve(n_edges);
+    for(int k = 0; k < n_edges; ++k) {
+        edge_list.push_back(std::make_pair(rand() % n_vertices, rand() % n_vertices));
+    }
+    return edge_list;
+}
+
+void create_random_graph(int n_vertices, int n_edges, int& edges)
+{
+    TAdjacencyListGraph<> graph(n_vertices);
+    fill_random_graph(graph, n_edges);
+    edges = graph.edges();
+}
+
+void measure_random_graph(int n_vertices, int n_edges)
+{
+    int edges;
+    std::cout << "Creating unoriented random graph with "
+              << n_vertices
+              << " vertices and "
+              << n_edges
+              << " edge insertions takes "
+              << Nstd::measure<>::execution(create_random_graph, n_vertices, n_edges, edges)
+              << "us"
+              << std::endl;
+    std::cout << "Resulting graph has "
+              << edges
+              << " edges"
+              << std::endl;
+}
+
 void measure_clique_graph(int n_vertices)
 {
     int edges;
@@ -64,12 +160,359 @@ void measure_clique_graph(int n_vertices)
               << std::endl;
 }
 
+void create_clique_graph_csr(int n_vertices, int& edges)
+{
+    EdgeVector edge_list;
+    edge_list.reserve(n_vertices * n_vertices);
+    for(int i = 0; i < n_vertices; ++i) {
+        for(int j = n_vertices - 1; j >= 0; --j) {
+            edge_list.push_back(std::make_pair(i, j));
+        }
+    }
+    TAdjacencyListGraph<graph_traits::oriented, graph_traits::csr> graph(n_vertices, edge_list.begin(), edge_list.end());
+    edges = graph.edges();
+}
+
+template<class Graph>
+void scan_neighbours(const Graph& graph, long long& sum)
+{
+    sum = 0;
+    for(int i = 0; i < graph.vertices(); ++i) {
+        for(int j : graph.neighbours(i)) {
+            sum += j;
+        }
+    }
+}
+
+void measure_csr_clique_graph(int n_vertices)
+{
+    int edges;
+    std::cout << "Creating oriented CSR clique graph with "
+              << n_vertices
+              << " vertices takes "
+              << Nstd::measure<>::execution(create_clique_graph_csr, n_vertices, edges)
+              << "us"
+              << std::endl;
+    std::cout << "Resulting graph has "
+              << edges
+              << " edges"
+              << std::endl;
+
+    EdgeVector edge_list;
+    for(int i = 0; i < n_vertices; ++i) {
+        for(int j = 0; j < n_vertices; ++j) {
+            edge_list.push_back(std::make_pair(i, j));
+        }
+    }
+    TAdjacencyListGraph<graph_traits::oriented, graph_traits::csr> graph(n_vertices, edge_list.begin(), edge_list.end());
+    long long sum;
+    std::cout << "Scanning all neighbours of CSR clique graph with "
+              << n_vertices
+              << " vertices takes "
+              << Nstd::measure<>::execution(scan_neighbours<decltype(graph)>, graph, sum)
+              << "us"
+              << std::endl;
+    assert(sum == (long long)n_vertices * n_vertices * (n_vertices - 1) / 2);
+}
+
+void test_traversal()
+{
+    // 0 - 1 - 2    3 - 4    5
+    //  \_____/
+    TAdjacencyListGraph<> gr(6);
+    gr.add_edge(0, 1);
+    gr.add_edge(1, 2);
+    gr.add_edge(2, 0);
+    gr.add_edge(3, 4);
+
+    std::vector<int> order, depths;
+    Nstd::breadth_first_search(gr, 1, [&] (int v, int d) { order.push_back(v); depths.push_back(d); });
+    assert(order == std::vector<int>({1, 0, 2}));
+    assert(depths == std::vector<int>({0, 1, 1}));
+
+    order.clear();
+    Nstd::depth_first_search(gr, 0, [&] (int v) { order.push_back(v); });
+    assert(order == std::vector<int>({0, 1, 2}));
+
+    std::vector<int> component(6, -1);
+    assert(Nstd::connected_components(gr, [&] (int v, int c) { component[v] = c; }) == 3);
+    assert(component == std::vector<int>({0, 0, 0, 1, 1, 2}));
+
+    EdgeVector edges({ {0, 1}, {1, 2}, {2, 0}, {3, 4} });
+    TAdjacencyListGraph<graph_traits::unoriented, graph_traits::csr> csr(6, edges.begin(), edges.end());
+    assert(Nstd::connected_components(csr, [] (int, int) {}) == 3);
+
+    // 5 -> 0 -> 2 -> 3, 4 -> 2, 1 -> 3
+    TAdjacencyListGraph<graph_traits::oriented> dag(6);
+    dag.add_edge(5, 0);
+    dag.add_edge(0, 2);
+    dag.add_edge(2, 3);
+    dag.add_edge(4, 2);
+    dag.add_edge(1, 3);
+    std::vector<int> position(6, -1);
+    int next = 0;
+    assert(Nstd::topological_sort(dag, [&] (int v) { position[v] = next++; }));
+    assert(next == 6);
+    assert(position[5] < position[0]);
+    assert(position[0] < position[2]);
+    assert(position[4] < position[2]);
+    assert(position[2] < position[3]);
+    assert(position[1] < position[3]);
+
+    dag.add_edge(3, 5);
+    next = 0;
+    assert(!Nstd::topological_sort(dag, [&] (int v) { ++next; }));
+    assert(next == 0);
+}
+
+template<class Graph>
+void run_traversals(const Graph& graph, long long& visited)
+{
+    visited = 0;
+    Nstd::breadth_first_search(graph, 0, [&visited] (int v, int d) { visited += d; });
+    Nstd::depth_first_search(graph, 0, [&visited] (int v) { ++visited; });
+    visited += Nstd::connected_components(graph, [] (int v, int c) {});
+}
+
+template<class Graph>
+void measure_traversals(const Graph& graph, const char* name)
+{
+    long long visited;
+    std::cout << "BFS, DFS and connected components over "
+              << name
+              << " with "
+              << graph.vertices()
+              << " vertices and "
+              << graph.edges()
+              << " edges take "
+              << Nstd::measure<>::execution(run_traversals<Graph>, graph, visited)
+              << "us"
+              << std::endl;
+}
+
+void measure_traversals()
+{
+    for(int n_vertices = 200; n_vertices <= 1600; n_vertices *= 2) {
+        TAdjacencyListGraph<> clique(n_vertices);
+        for(int i = 0; i < n_vertices; ++i) {
+            for(int j = n_vertices - 1; j >= i; --j) {
+                clique.add_edge(i, j);
+            }
+        }
+        measure_traversals(clique, "clique graph");
+    }
+
+    TAdjacencyListGraph<> sparse(1000000);
+    fill_random_graph(sparse, 2000000);
+    measure_traversals(sparse, "sparse random graph");
+
+    EdgeVector edges = random_edges(1000000, 2000000);
+    TAdjacencyListGraph<graph_traits::unoriented, graph_traits::csr> csr(1000000, edges.begin(), edges.end());
+    measure_traversals(csr, "sparse random CSR graph");
+}
+
+void test_parallel_bfs()
+{
+    EdgeVector edges = random_edges(10000, 30000);
+    TAdjacencyListGraph<graph_traits::unoriented, graph_traits::csr> graph(10000, edges.begin(), edges.end());
+
+    std::vector<int> expected(graph.vertices(), -1);
+    Nstd::breadth_first_search(graph, 0, [&expected] (int v, int d) { expected[v] = d; });
+
+    for(int n_threads = 1; n_threads <= 4; ++n_threads) {
+        std::vector<int> depth;
+        Nstd::parallel_breadth_first_search(graph, 0, depth, n_threads);
+        assert(depth == expected);
+        Nstd::parallel_breadth_first_search(graph, 0, depth, n_threads, false);
+        assert(depth == expected);
+    }
+}
+
+template<class Graph>
+void run_parallel_bfs(const Graph& graph, int n_threads, bool direction_optimizing, long long& inspected)
+{
+    std::vector<int> depth;
+    inspected = Nstd::parallel_breadth_first_search(graph, 0, depth, n_threads, direction_optimizing);
+}
+
+void measure_parallel_bfs()
+{
+    const int n_vertices = 1000000;
+    EdgeVector edges = random_edges(n_vertices, 8000000);
+    typedef TAdjacencyListGraph<graph_traits::unoriented, graph_traits::csr> Graph;
+    Graph graph(n_vertices, edges.begin(), edges.end());
+
+    int max_threads = std::max(4, (int)std::thread::hardware_concurrency());
+    for(int n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+        for(int direction_optimizing = 0; direction_optimizing < 2; ++direction_optimizing) {
+            long long inspected;
+            std::cout << (direction_optimizing ? "Direction-optimizing" : "Top-down")
+                      << " BFS over random graph with "
+                      << graph.vertices()
+                      << " vertices and "
+                      << graph.edges()
+                      << " edges on "
+                      << n_threads
+                      << " threads takes "
+                      << Nstd::measure<>::execution(run_parallel_bfs<Graph>, graph, n_threads, direction_optimizing != 0, inspected)
+                      << "us, "
+                      << inspected
+                      << " edges inspected"
+                      << std::endl;
+        }
+    }
+}
+
+void test_weighted_edges()
+{
+    TAdjacencyListGraph<graph_traits::unoriented, graph_traits::linked, double> gr1(4);
+    assert(gr1.add_edge(0, 2, 1.5));
+    assert(gr1.add_edge(0, 1, 2.5));
+    assert(!gr1.add_edge(1, 0, 7.0));
+    std::vector<double> w0(gr1.edge_values(0).begin(), gr1.edge_values(0).end());
+    assert(w0 == std::vector<double>({2.5, 1.5}));
+    assert(*gr1.edge_values(1).begin() == 2.5);
+
+    EdgeVector edges({ {2, 0}, {0, 1}, {0, 2} });
+    std::vector<int> values({ 3, 4, 5 });
+    TAdjacencyListGraph<graph_traits::oriented, graph_traits::csr, int> gr2(3, edges.begin(), edges.end(), values.begin());
+    std::vector<int> w2(gr2.edge_values(0).begin(), gr2.edge_values(0).end());
+    assert(w2 == std::vector<int>({4, 5}));
+    assert(*gr2.edge_values(2).begin() == 3);
+    TAdjacencyListGraph<graph_traits::unoriented, graph_traits::csr, int> gr3(3, edges.begin(), edges.end(), values.begin());
+    assert(gr3.edges() == 2);
+    std::vector<int> w3(gr3.edge_values(0).begin(), gr3.edge_values(0).end());
+    assert(w3 == std::vector<int>({4, 3}));
+}
+
+template<class Graph>
+std::vector<int> bellman_ford(const Graph& graph, int source)
+{
+    std::vector<int> distance(graph.vertices(), std::numeric_limits<int>::max());
+    distance[source] = 0;
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int v = 0; v < graph.vertices(); ++v) {
+            if (distance[v] == std::numeric_limits<int>::max()) {
+                continue;
+            }
+            const int* w = graph.edge_values(v).begin();
+            for (int u : graph.neighbours(v)) {
+                if (distance[v] + *w < distance[u]) {
+                    distance[u] = distance[v] + *w;
+                    changed = true;
+                }
+                ++w;
+            }
+        }
+    }
+    return distance;
+}
+
+template<int Arity, class Graph>
+void check_dijkstra(const Graph& graph)
+{
+    std::vector<int> expected = bellman_ford(graph, 0);
+    std::vector<int> distance;
+    Nstd::dijkstra<Arity>(graph, 0, distance);
+    assert(distance == expected);
+}
+
+void test_dijkstra()
+{
+    TIndexedHeap<int, 4> heap(10);
+    for (int i = 0; i < 10; ++i) {
+        heap.push(i, 100 - i);
+    }
+    heap.decrease_key(3, 1);
+    heap.decrease_key(7, 0);
+    assert(heap.pop() == 7);
+    assert(heap.pop() == 3);
+    assert(heap.pop() == 9);
+    assert(heap.size() == 7);
+
+    TAdjacencyListGraph<graph_traits::oriented, graph_traits::linked, int> linked(2000);
+    for (int k = 0; k < 10000; ++k) {
+        linked.add_edge(rand() % 2000, rand() % 2000, rand() % 100);
+    }
+    check_dijkstra<2>(linked);
+    check_dijkstra<4>(linked);
+    check_dijkstra<8>(linked);
+
+    EdgeVector edges = random_edges(2000, 6000);
+    std::vector<int> values;
+    for (size_t k = 0; k < edges.size(); ++k) {
+        values.push_back(rand() % 100);
+    }
+    TAdjacencyListGraph<graph_traits::unoriented, graph_traits::csr, int> csr(2000, edges.begin(), edges.end(), values.begin());
+    check_dijkstra<2>(csr);
+    check_dijkstra<4>(csr);
+    check_dijkstra<8>(csr);
+}
+
+template<int Arity, class Graph>
+void run_dijkstra(const Graph& graph, int queries)
+{
+    TIndexedHeap<int, Arity> heap(graph.vertices());
+    std::vector<int> distance;
+    for (int q = 0; q < queries; ++q) {
+        Nstd::dijkstra(graph, (q * 7919) % graph.vertices(), distance, heap);
+    }
+}
+
+template<class Graph>
+void measure_dijkstra(const Graph& graph, const char* name, int queries)
+{
+    std::cout << queries << " Dijkstra queries over " << name << " with " << graph.vertices() << " vertices and " << graph.edges() << " edges take "
+              << Nstd::measure<>::execution(run_dijkstra<2, Graph>, graph, queries) << "us with a binary heap, "
+              << Nstd::measure<>::execution(run_dijkstra<4, Graph>, graph, queries) << "us with a 4-ary heap, "
+              << Nstd::measure<>::execution(run_dijkstra<8, Graph>, graph, queries) << "us with an 8-ary heap"
+              << std::endl;
+}
+
+void measure_dijkstra()
+{
+    const int n_clique = 800;
+    TAdjacencyListGraph<graph_traits::unoriented, graph_traits::linked, int> clique(n_clique);
+    for(int i = 0; i < n_clique; ++i) {
+        for(int j = n_clique - 1; j >= i; --j) {
+            clique.add_edge(i, j, 1 + rand() % 1000);
+        }
+    }
+    measure_dijkstra(clique, "weighted clique graph", 10);
+
+    const int n_sparse = 300000;
+    EdgeVector edges = random_edges(n_sparse, 1200000);
+    std::vector<int> values;
+    values.reserve(edges.size());
+    for (size_t k = 0; k < edges.size(); ++k) {
+        values.push_back(1 + rand() % 1000);
+    }
+    TAdjacencyListGraph<graph_traits::unoriented, graph_traits::csr, int> sparse(n_sparse, edges.begin(), edges.end(), values.begin());
+    measure_dijkstra(sparse, "weighted sparse random CSR graph", 3);
+}
+
 int main(int argc, char* argv[])
 {
     test_adj_list_basic();
+    test_csr_basic();
+    test_traversal();
+    test_parallel_bfs();
+    test_weighted_edges();
+    test_dijkstra();
     measure_clique_graph(100);
     measure_clique_graph(200);
     measure_clique_graph(400);
     measure_clique_graph(800);
+    measure_clique_graph(1600);
+    measure_random_graph(1000000, 2000000);
+    measure_csr_clique_graph(100);
+    measure_csr_clique_graph(200);
+    measure_csr_clique_graph(400);
+    measure_csr_clique_graph(800);
+    measure_csr_clique_graph(1600);
+    measure_traversals();
+    measure_parallel_bfs();
+    measure_dijkstra();
     return 0;
 }
\ No newline at end of file
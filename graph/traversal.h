@@ -0,0 +1,153 @@
+#pragma once
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <bool_array.h>
+#include "adjacency_list.h"
+
+namespace Nstd {
+
+// Visitors are taken by template parameter so that the traversal loops
+// can be inlined around them. Visited vertices are tracked in a packed
+// nvwa::bool_array, one bit per vertex.
+
+template<class Graph, class Visitor>
+void breadth_first_search_internal(const Graph& graph, int source, nvwa::bool_array& visited,
+                                   std::vector<int>& queue, Visitor& visit)
+{
+    queue.clear();
+    queue.push_back(source);
+    visited[source] = true;
+    size_t level_end = 1;
+    int depth = 0;
+    for (size_t head = 0; head < queue.size(); ++head) {
+        if (head == level_end) {
+            level_end = queue.size();
+            ++depth;
+        }
+        int v = queue[head];
+        visit(v, depth);
+        for (int u : graph.neighbours(v)) {
+            if (!visited[u]) {
+                visited[u] = true;
+                queue.push_back(u);
+            }
+        }
+    }
+}
+
+template<class Graph, class Visitor>
+void depth_first_search_internal(const Graph& graph, int source, nvwa::bool_array& visited, Visitor& visit)
+{
+    typedef typename Graph::NeighbourIterator NeighbourIterator;
+    std::vector<std::pair<NeighbourIterator, NeighbourIterator>> stack;
+
+    visited[source] = true;
+    visit(source);
+    stack.push_back(std::make_pair(graph.neighbours(source).begin(), graph.neighbours(source).end()));
+    while (!stack.empty()) {
+        std::pair<NeighbourIterator, NeighbourIterator>& top = stack.back();
+        if (top.first == top.second) {
+            stack.pop_back();
+            continue;
+        }
+        int u = *top.first++;
+        if (!visited[u]) {
+            visited[u] = true;
+            visit(u);
+            stack.push_back(std::make_pair(graph.neighbours(u).begin(), graph.neighbours(u).end()));
+        }
+    }
+}
+
+// Calls visit(vertex, depth) for every vertex reachable from source, level by level.
+template<class Graph, class Visitor>
+void breadth_first_search(const Graph& graph, int source, Visitor visit)
+{
+    assert(source < graph.vertices());
+    nvwa::bool_array visited(graph.vertices());
+    visited.initialize(false);
+    std::vector<int> queue;
+    queue.reserve(graph.vertices());
+    breadth_first_search_internal(graph, source, visited, queue, visit);
+}
+
+// Calls visit(vertex) for every vertex reachable from source, in preorder.
+template<class Graph, class Visitor>
+void depth_first_search(const Graph& graph, int source, Visitor visit)
+{
+    assert(source < graph.vertices());
+    nvwa::bool_array visited(graph.vertices());
+    visited.initialize(false);
+    depth_first_search_internal(graph, source, visited, visit);
+}
+
+// Calls visit(vertex, component) for every vertex and returns the number of components.
+template<class Graph, class Visitor>
+int connected_components(const Graph& graph, Visitor visit)
+{
+    static_assert(std::is_same<typename Graph::OrientationType, graph_traits::unoriented>::value,
+                  "connected components are defined for unoriented graphs");
+    if (graph.vertices() == 0) {
+        return 0;
+    }
+    nvwa::bool_array visited(graph.vertices());
+    visited.initialize(false);
+    std::vector<int> queue;
+    queue.reserve(graph.vertices());
+
+    int component = 0;
+    auto visit_component = [&visit, &component] (int v, int) { visit(v, component); };
+    for (size_t start = visited.find(false); start != nvwa::bool_array::npos; start = visited.find(false, start + 1)) {
+        breadth_first_search_internal(graph, start, visited, queue, visit_component);
+        ++component;
+    }
+    return component;
+}
+
+// Calls visit(vertex) for every vertex in topological order. Returns false
+// without visiting anything if the graph has a cycle.
+template<class Graph, class Visitor>
+bool topological_sort(const Graph& graph, Visitor visit)
+{
+    static_assert(std::is_same<typename Graph::OrientationType, graph_traits::oriented>::value,
+                  "topological order is defined for oriented graphs");
+    typedef typename Graph::NeighbourIterator NeighbourIterator;
+    if (graph.vertices() == 0) {
+        return true;
+    }
+    nvwa::bool_array visited(graph.vertices()), finished(graph.vertices());
+    visited.initialize(false);
+    finished.initialize(false);
+    std::vector<int> order;
+    order.reserve(graph.vertices());
+    std::vector<std::pair<int, NeighbourIterator>> stack;
+
+    for (size_t start = visited.find(false); start != nvwa::bool_array::npos; start = visited.find(false, start + 1)) {
+        visited[start] = true;
+        stack.push_back(std::make_pair(start, graph.neighbours(start).begin()));
+        while (!stack.empty()) {
+            std::pair<int, NeighbourIterator>& top = stack.back();
+            if (top.second == graph.neighbours(top.first).end()) {
+                finished[top.first] = true;
+                order.push_back(top.first);
+                stack.pop_back();
+                continue;
+            }
+            int u = *top.second++;
+            if (!visited[u]) {
+                visited[u] = true;
+                stack.push_back(std::make_pair(u, graph.neighbours(u).begin()));
+            } else if (!finished[u]) {
+                // back edge to a vertex still on the stack
+                return false;
+            }
+        }
+    }
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        visit(*it);
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,187 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Monotonic arena in the shape of a standard allocator. Blocks are carved
+// from malloc'ed slabs that double in size up to max_slab_bytes; single
+// blocks that are given back go to a free list and are handed out again
+// by the next allocate(1), and release() returns all slabs at once.
+//
+// The arena lives inside the allocator object. A copy starts with an empty
+// arena of its own, so a container holding its allocator by value is the
+// only user of its slabs and may release() them without visiting the nodes.
+template<class T>
+class TArenaAllocator {
+public:
+    typedef T value_type;
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    static const size_t first_slab_bytes = 4096;
+    static const size_t max_slab_bytes = 1 << 20;
+
+    TArenaAllocator()
+    {
+        initialize();
+    }
+
+    TArenaAllocator(const TArenaAllocator&)
+    {
+        initialize();
+    }
+
+    template<class U>
+    TArenaAllocator(const TArenaAllocator<U>&)
+    {
+        initialize();
+    }
+
+    TArenaAllocator(TArenaAllocator&& other)
+    {
+        initialize();
+        swap(other);
+    }
+
+    ~TArenaAllocator()
+    {
+        release();
+    }
+
+    // keeps its own arena, the blocks of this allocator stay valid
+    TArenaAllocator& operator=(const TArenaAllocator&)
+    {
+        return *this;
+    }
+
+    TArenaAllocator& operator=(TArenaAllocator&& other)
+    {
+        release();
+        swap(other);
+        return *this;
+    }
+
+    void swap(TArenaAllocator& other)
+    {
+        std::swap(slabs, other.slabs);
+        std::swap(cur, other.cur);
+        std::swap(end, other.end);
+        std::swap(free_list, other.free_list);
+        std::swap(next_slab_bytes, other.next_slab_bytes);
+        std::swap(n_slabs, other.n_slabs);
+    }
+
+    T* allocate(size_t n)
+    {
+        if (n == 1 && free_list != 0) {
+            FreeBlock* block = free_list;
+            free_list = block->next;
+            return reinterpret_cast<T*>(block);
+        }
+        size_t bytes = round_up(n * sizeof(T));
+        if (static_cast<size_t>(end - cur) < bytes) {
+            add_slab(bytes);
+        }
+        T* result = reinterpret_cast<T*>(cur);
+        cur += bytes;
+        return result;
+    }
+
+    // Only single blocks are reused; larger blocks wait for release().
+    void deallocate(T* p, size_t n)
+    {
+        if (n == 1) {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(p);
+            block->next = free_list;
+            free_list = block;
+        }
+    }
+
+    // Frees every slab. All blocks handed out so far become invalid.
+    void release()
+    {
+        while (slabs != 0) {
+            Slab* next = slabs->next;
+            std::free(slabs);
+            slabs = next;
+        }
+        initialize();
+    }
+
+    int slab_count() const
+    {
+        return n_slabs;
+    }
+
+    bool operator==(const TArenaAllocator& other) const
+    {
+        return this == &other;
+    }
+
+    bool operator!=(const TArenaAllocator& other) const
+    {
+        return this != &other;
+    }
+
+private:
+    struct Slab {
+        Slab* next;
+    };
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static const size_t block_align = alignof(T) > alignof(FreeBlock) ? alignof(T) : alignof(FreeBlock);
+    static const size_t header_bytes = (sizeof(Slab) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+    Slab* slabs;
+    char* cur;
+    char* end;
+    FreeBlock* free_list;
+    size_t next_slab_bytes;
+    int n_slabs;
+
+    void initialize()
+    {
+        slabs = 0;
+        cur = 0;
+        end = 0;
+        free_list = 0;
+        next_slab_bytes = first_slab_bytes;
+        n_slabs = 0;
+    }
+
+    static size_t round_up(size_t bytes)
+    {
+        if (bytes < sizeof(FreeBlock)) {
+            bytes = sizeof(FreeBlock);
+        }
+        return (bytes + block_align - 1) & ~(block_align - 1);
+    }
+
+    void add_slab(size_t bytes)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+        size_t slab_bytes = next_slab_bytes;
+        while (slab_bytes < bytes + header_bytes) {
+            slab_bytes *= 2;
+        }
+        if (next_slab_bytes < max_slab_bytes) {
+            next_slab_bytes *= 2;
+        }
+        // the tail of the current slab is dropped until release()
+        Slab* slab = static_cast<Slab*>(std::malloc(slab_bytes));
+        if (slab == 0) {
+            throw std::bad_alloc();
+        }
+        slab->next = slabs;
+        slabs = slab;
+        ++n_slabs;
+        cur = reinterpret_cast<char*>(slab) + header_bytes;
+        end = reinterpret_cast<char*>(slab) + slab_bytes;
+    }
+};
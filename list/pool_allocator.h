@@ -0,0 +1,11 @@
+#pragma once
+#include <mem_pool_allocator.h>
+
+// Standard allocator over the process-wide nvwa::static_mem_pool of the
+// size class of T: single objects are taken from the pool and given back
+// to it, so a node freed by one container is reused by the next one, even
+// one of another node type of about the same size. Arrays and objects
+// above POOL_ALLOCATOR_MAX_SIZE go to the system. Stateless, all
+// instances are equal.
+template<class T>
+using TPoolAllocator = nvwa::pool_allocator<T>;
@@ -1,16 +1,24 @@
 #pragma once
 #include <assert.h>
 #include <iostream>
+#include <memory>
+#include <type_traits>
 #include <debug_new.h>
 #include <merge.h>
+#include "arena_allocator.h"
 
-template<class Value>
+// Nodes come from Alloc rebound to the node type. With TArenaAllocator
+// every list carves its nodes from its own slabs, and clear() hands the
+// slabs back at once instead of freeing the nodes one by one.
+template<class Value, class Alloc = std::allocator<Value>>
 class TSingleLinkedList {
 public:
     class ForwardIterator;
 
 private:
     class Node;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Node> NodeAlloc;
+    typedef std::allocator_traits<NodeAlloc> NodeAllocTraits;
 
 public:
     TSingleLinkedList()
@@ -18,6 +26,12 @@ public:
         initialize();
     }
 
+    explicit TSingleLinkedList(const Alloc& alloc) :
+        node_alloc( alloc )
+    {
+        initialize();
+    }
+
     ~TSingleLinkedList()
     {
         clear();
@@ -30,13 +44,15 @@ public:
         Nstd::copy(init.begin(), init.end(), begin());
     }
 
-    TSingleLinkedList(const TSingleLinkedList& other)
+    TSingleLinkedList(const TSingleLinkedList& other) :
+        node_alloc( NodeAllocTraits::select_on_container_copy_construction(other.node_alloc) )
     {
         initialize();
         *this = other;
     }
 
-    TSingleLinkedList(TSingleLinkedList&& other)
+    TSingleLinkedList(TSingleLinkedList&& other) :
+        node_alloc( std::move(other.node_alloc) )
     {
         initialize();
         std::swap(head, other.head);
@@ -51,9 +67,11 @@ public:
         Nstd::copy(other.begin(), other.end(), begin());
     }
 
+    // the nodes of other move over together with the allocator that owns them
     void operator=(TSingleLinkedList&& other)
     {
         clear();
+        std::swap(node_alloc, other.node_alloc);
         std::swap(head, other.head);
         std::swap(tail, other.tail);
         std::swap(sz, other.sz);
@@ -72,12 +90,32 @@ public:
 
     void clear() 
     {
-        while (sz > 0) {
-            pop_front();
-        }
+        free_nodes(node_alloc);
+        initialize();
     }
 
     void push_front(const Value& v) 
+    {
+        emplace_front(v);
+    }
+
+    void push_front(Value&& v) 
+    {
+        emplace_front(std::move(v));
+    }
+
+    void push_back(const Value& v) 
+    {
+        emplace_back(v);
+    }
+
+    void push_back(Value&& v) 
+    {
+        emplace_back(std::move(v));
+    }
+
+    template<class... Args>
+    void emplace_front(Args&&... args)
     {
         if(sz == 0) {
             assert(head == 0);
@@ -85,14 +123,15 @@ public:
         }
         if(head == 0) {
             assert(tail == 0);
-            head = tail = new Node(v);
+            head = tail = create_node(0, std::forward<Args>(args)...);
         } else {
-            head = new Node(v, head);
+            head = create_node(head, std::forward<Args>(args)...);
         }
         ++sz;
     }
 
-    void push_back(const Value& v) 
+    template<class... Args>
+    void emplace_back(Args&&... args)
     {
         if(sz == 0) {
             assert(head == 0);
@@ -100,24 +139,39 @@ public:
         }
         if(tail == 0) {
             assert(head == 0);
-            head = tail = new Node(v);
+            head = tail = create_node(0, std::forward<Args>(args)...);
         } else {
-            tail = tail->next = new Node(v);
+            tail = tail->next = create_node(0, std::forward<Args>(args)...);
         }
         ++sz;
     }
 
-    void insert(const ForwardIterator& it, const Value& v)
+    // Constructs a value right after it and returns an iterator to it.
+    template<class... Args>
+    ForwardIterator emplace_after(const ForwardIterator& it, Args&&... args)
     {
         assert(it.node != 0);
-        Node* newnode = new Node(std::move(it.node->v));
-        it.node->v = v;
-        newnode->next = it.node->next;
+        Node* newnode = create_node(it.node->next, std::forward<Args>(args)...);
         it.node->next = newnode;
         if (tail == it.node) {
             tail = newnode;
         }
         sz++;
+        return ForwardIterator(newnode);
+    }
+
+    // Inserts v in front of the value it points to; it then points to v.
+    // The old value moves on into a new node behind it.
+    void insert(const ForwardIterator& it, const Value& v)
+    {
+        emplace_after(it, std::move(it.node->v));
+        it.node->v = v;
+    }
+
+    void insert(const ForwardIterator& it, Value&& v)
+    {
+        emplace_after(it, std::move(it.node->v));
+        it.node->v = std::move(v);
     }
 
     Value pop_front()
@@ -126,8 +180,8 @@ public:
         assert(head != 0);
         Node* tmp = head;
         head = head->next;
-        Value ret = tmp->v;
-        delete tmp;
+        Value ret = std::move(tmp->v);
+        destroy_node(tmp);
         if(--sz == 0) {
             tail = head;
         } 
@@ -141,14 +195,162 @@ public:
         }
     }
 
+    // The operations below relink the nodes of other without allocating.
+    // Nodes can only change lists when both allocators compare equal; a
+    // TArenaAllocator list owns its nodes, so from or into such a list the
+    // values are moved into new nodes instead.
+
+    // Moves all of other to the end of this list.
+    void append(TSingleLinkedList&& other)
+    {
+        if (this == &other || other.sz == 0) {
+            return;
+        }
+        if (!(node_alloc == other.node_alloc)) {
+            for (Node* node = other.head; node != 0; node = node->next) {
+                emplace_back(std::move(node->v));
+            }
+            other.clear();
+            return;
+        }
+        if (tail == 0) {
+            head = other.head;
+        } else {
+            tail->next = other.head;
+        }
+        tail = other.tail;
+        sz += other.sz;
+        other.initialize();
+    }
+
+    // Moves all of other right after pos.
+    void splice_after(const ForwardIterator& pos, TSingleLinkedList&& other)
+    {
+        assert(pos.node != 0);
+        assert(this != &other);
+        if (other.sz == 0) {
+            return;
+        }
+        if (!(node_alloc == other.node_alloc)) {
+            ForwardIterator it = pos;
+            for (Node* node = other.head; node != 0; node = node->next) {
+                it = emplace_after(it, std::move(node->v));
+            }
+            other.clear();
+            return;
+        }
+        other.tail->next = pos.node->next;
+        pos.node->next = other.head;
+        if (tail == pos.node) {
+            tail = other.tail;
+        }
+        sz += other.sz;
+        other.initialize();
+    }
+
+    // Cuts the list in front of it: this list keeps [begin(), it) and
+    // [it, end()) is returned. Takes time linear in the length of the part kept.
+    TSingleLinkedList split_at(const ForwardIterator& it)
+    {
+        TSingleLinkedList rest(node_alloc);
+        if (it.node == 0) {
+            return rest;
+        }
+        Node* last_kept = 0;
+        int kept = 0;
+        for (Node* node = head; node != it.node; node = node->next) {
+            assert(node != 0);
+            last_kept = node;
+            ++kept;
+        }
+        if (!(node_alloc == rest.node_alloc)) {
+            for (Node* node = it.node; node != 0; ) {
+                Node* next = node->next;
+                rest.emplace_back(std::move(node->v));
+                destroy_node(node);
+                node = next;
+            }
+        } else {
+            rest.head = it.node;
+            rest.tail = tail;
+            rest.sz = sz - kept;
+        }
+        if (last_kept == 0) {
+            head = 0;
+        } else {
+            last_kept->next = 0;
+        }
+        tail = last_kept;
+        sz = kept;
+        return rest;
+    }
+
+    // Merges the sorted list other into this sorted list. Stable: of equal
+    // values, those of this list come first.
+    void merge(TSingleLinkedList&& other)
+    {
+        if (this == &other) {
+            return;
+        }
+        Node* first_tail = tail;
+        append(std::move(other));
+        if (first_tail == 0 || first_tail->next == 0) {
+            return;
+        }
+        Node* second = first_tail->next;
+        first_tail->next = 0;
+        if (tail->v < first_tail->v) {
+            tail = first_tail;
+        }
+        head = merge_runs(head, second);
+    }
+
     int size() const 
     {
         return sz;
     }
 
-    TSingleLinkedList<Value> sorted()
+    TSingleLinkedList sorted() const
     {
-        return sorted(begin(), end());
+        TSingleLinkedList res(*this);
+        res.sort();
+        return res;
+    }
+
+    // Stable bottom-up merge sort that relinks the nodes in place and
+    // allocates nothing. bins[i] holds a sorted run of 2^i nodes; nodes are
+    // taken off the list one at a time and carried through the bins like
+    // the bits of a binary counter, so every run is merged with one of the
+    // same length.
+    void sort()
+    {
+        if (sz < 2) {
+            return;
+        }
+        Node* bins[sizeof(int) * 8] = {};
+        int used_bins = 0;
+        while (head != 0) {
+            Node* run = head;
+            head = head->next;
+            run->next = 0;
+            int i = 0;
+            for (; i < used_bins && bins[i] != 0; ++i) {
+                run = merge_runs(bins[i], run);
+                bins[i] = 0;
+            }
+            bins[i] = run;
+            if (i == used_bins) {
+                ++used_bins;
+            }
+        }
+        // higher bins hold earlier nodes
+        for (int i = 0; i < used_bins; ++i) {
+            if (bins[i] != 0) {
+                head = head == 0 ? bins[i] : merge_runs(bins[i], head);
+            }
+        }
+        for (tail = head; tail->next != 0; tail = tail->next) {
+        }
     }
 
 public:
@@ -200,6 +402,7 @@ public:
     };
 
 private:
+    NodeAlloc node_alloc;
     Node* head;
     Node* tail;
     int sz;
@@ -211,31 +414,62 @@ private:
         sz = 0;
     }
 
-    TSingleLinkedList<Value> sorted(ForwardIterator first, ForwardIterator last)
+    template<class... Args>
+    Node* create_node(Node* next, Args&&... args)
     {
-        TSingleLinkedList<Value> res;
-        int steps = 0;
-        if (first != last) {
-            ForwardIterator it1 = first, it2 = first;
-            while (++it1 != last && ++it2 != last && ++it2 != last) { ++steps; }
-            if (it1 == last) {
-                // single-element list
-                res.reserve(1);
-                Nstd::copy(first, last, res.begin());
+        Node* node = NodeAllocTraits::allocate(node_alloc, 1);
+        NodeAllocTraits::construct(node_alloc, node, next, std::forward<Args>(args)...);
+        return node;
+    }
+
+    void destroy_node(Node* node)
+    {
+        NodeAllocTraits::destroy(node_alloc, node);
+        NodeAllocTraits::deallocate(node_alloc, node, 1);
+    }
+
+    template<class AnyAlloc>
+    void free_nodes(AnyAlloc&)
+    {
+        while (head != 0) {
+            Node* next = head->next;
+            destroy_node(head);
+            head = next;
+        }
+    }
+
+    // the list is the only user of its arena, so the slabs go back whole
+    template<class T>
+    void free_nodes(TArenaAllocator<T>& arena)
+    {
+        if (!std::is_trivially_destructible<Value>::value) {
+            for (Node* node = head; node != 0; ) {
+                Node* next = node->next;
+                NodeAllocTraits::destroy(node_alloc, node);
+                node = next;
+            }
+        }
+        arena.release();
+    }
+
+    // Merges two null-terminated sorted runs; on ties the node of first
+    // goes first, which keeps sort() stable.
+    static Node* merge_runs(Node* first, Node* second)
+    {
+        Node* merged = 0;
+        Node** link = &merged;
+        while (first != 0 && second != 0) {
+            if (second->v < first->v) {
+                *link = second;
+                second = second->next;
             } else {
-                if(steps == 0) {
-                    // two-element list, no need to recurse
-                    res.push_back(std::min(*first, *it1));
-                    res.push_back(std::max(*first, *it1));
-                } else {
-                    TSingleLinkedList<Value> tmp1 = sorted(first, it1);
-                    TSingleLinkedList<Value> tmp2 = sorted(it1, last);
-                    res.reserve(tmp1.size() + tmp2.size());
-                    Nstd::merge(tmp1.begin(), tmp1.end(), tmp2.begin(), tmp2.end(), res.begin());
-                }
+                *link = first;
+                first = first->next;
             }
+            link = &(*link)->next;
         }
-        return res;
+        *link = first != 0 ? first : second;
+        return merged;
     }
 
 private:
@@ -243,14 +477,17 @@ private:
     friend class TSingleLinkedList;
     friend class TSingleLinkedList::ForwardIterator;
 
-    private:
-        Value v;
-        Node* next;
-
-        Node(const Value& _v, Node* _next = 0) : 
-            v(_v),
+    public:
+        // public for std::allocator_traits::construct, Node itself is private
+        template<class... Args>
+        Node(Node* _next, Args&&... args) : 
+            v(std::forward<Args>(args)...),
             next(_next)
         {
         }
+
+    private:
+        Value v;
+        Node* next;
     };
 };
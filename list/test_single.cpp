@@ -1,6 +1,15 @@
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
 #include <single_list.h>
+#include <arena_allocator.h>
+#include <unrolled_list.h>
+#include <pool_allocator.h>
 #include <merge.h>
+#include <measure.h>
 #include <debug_new.h>
 
 template<class Value>
@@ -207,6 +216,219 @@ void test_sorted()
     std::cout << std::endl;
 }
 
+void test_move_values()
+{
+    typedef TSingleLinkedList<int> IntListType;
+
+    TSingleLinkedList<IntListType> lists;
+    IntListType inner({1,2,3});
+    lists.push_back(std::move(inner));
+    assert(inner.size() == 0);
+    lists.emplace_back();
+    lists.emplace_front(IntListType({0}));
+    assert(lists.size() == 3);
+    assert(lists.begin()->size() == 1);
+    auto it = lists.emplace_after(lists.begin(), IntListType({4,5}));
+    assert(it->size() == 2);
+    lists.insert(it, IntListType({6}));
+    assert(it->size() == 1);
+
+    IntListType first = lists.pop_front();
+    assert(first.size() == 1);
+    assert(lists.pop_front().size() == 1);
+    assert(lists.pop_front().size() == 2);
+    assert(lists.pop_front().size() == 3);
+    assert(lists.pop_front().size() == 0);
+    assert(lists.size() == 0);
+
+    // move-only values
+    TSingleLinkedList<std::unique_ptr<int>> pointers;
+    pointers.push_back(std::unique_ptr<int>(new int(2)));
+    pointers.emplace_front(new int(0));
+    pointers.emplace_after(pointers.begin(), new int(1));
+    pointers.insert(pointers.begin(), std::unique_ptr<int>(new int(-1)));
+    int expected = -1;
+    for (const std::unique_ptr<int>& p : pointers) {
+        assert(*p == expected++);
+    }
+    assert(*pointers.pop_front() == -1);
+    assert(pointers.size() == 3);
+}
+
+template<class IntListType>
+void test_splice_list()
+{
+    IntListType lst({1,2,3});
+    lst.append(IntListType({4,5}));
+    lst.append(IntListType());
+    assert(lst.size() == 5);
+    IntListType empty;
+    empty.append(std::move(lst));
+    assert(lst.size() == 0);
+    assert(lst.begin() == lst.end());
+    lst = std::move(empty);
+    lst.push_back(6);
+    assert(std::equal(lst.begin(), lst.end(), IntListType({1,2,3,4,5,6}).begin()));
+
+    lst.splice_after(lst.begin(), IntListType({10,11}));
+    IntListType other({20});
+    auto last = lst.begin();
+    for (int i = 1; i < lst.size(); ++i) {
+        ++last;
+    }
+    lst.splice_after(last, std::move(other));
+    assert(other.size() == 0);
+    lst.push_back(21);
+    assert(lst.size() == 10);
+    assert(std::equal(lst.begin(), lst.end(), IntListType({1,10,11,2,3,4,5,6,20,21}).begin()));
+
+    auto it = lst.begin();
+    for (int i = 0; i < 3; ++i) {
+        ++it;
+    }
+    IntListType rest = lst.split_at(it);
+    assert(lst.size() == 3);
+    assert(rest.size() == 7);
+    lst.push_back(12);
+    rest.push_back(22);
+    assert(std::equal(lst.begin(), lst.end(), IntListType({1,10,11,12}).begin()));
+    assert(std::equal(rest.begin(), rest.end(), IntListType({2,3,4,5,6,20,21,22}).begin()));
+    IntListType all = rest.split_at(rest.begin());
+    assert(rest.size() == 0);
+    assert(rest.begin() == rest.end());
+    assert(all.size() == 8);
+    assert(lst.split_at(lst.end()).size() == 0);
+
+    lst.merge(std::move(all));
+    assert(lst.size() == 12);
+    assert(std::equal(lst.begin(), lst.end(), IntListType({1,2,3,4,5,6,10,11,12,20,21,22}).begin()));
+    lst.push_back(30);
+    lst.merge(IntListType({0,7,40}));
+    assert(std::equal(lst.begin(), lst.end(), IntListType({0,1,2,3,4,5,6,7,10,11,12,20,21,22,30,40}).begin()));
+    IntListType merged;
+    merged.merge(std::move(lst));
+    assert(merged.size() == 16);
+    merged.push_back(50);
+    assert(std::is_sorted(merged.begin(), merged.end()));
+}
+
+void test_splice()
+{
+    test_splice_list<TSingleLinkedList<int>>();
+    test_splice_list<TSingleLinkedList<int, TArenaAllocator<int>>>();
+    test_splice_list<TSingleLinkedList<int, TPoolAllocator<int>>>();
+
+    // merge keeps equal values of the left list in front
+    TSingleLinkedList<std::pair<int, int>> left({{1, 0}, {2, 0}});
+    left.merge(TSingleLinkedList<std::pair<int, int>>({{1, 1}, {2, 1}}));
+    assert(std::equal(left.begin(), left.end(),
+                      TSingleLinkedList<std::pair<int, int>>({{1, 0}, {1, 1}, {2, 0}, {2, 1}}).begin()));
+}
+
+// ordered by key only, so that sort() stability can be observed
+struct TKeyed {
+    int key;
+    int order;
+
+    bool operator<(const TKeyed& other) const
+    {
+        return key < other.key;
+    }
+};
+
+void test_sort()
+{
+    typedef TSingleLinkedList<int> IntListType;
+
+    IntListType empty;
+    empty.sort();
+    assert(empty.size() == 0);
+    assert(empty.begin() == empty.end());
+
+    IntListType lst;
+    for (int i = 0; i < 1000; ++i) {
+        lst.push_back(std::rand() % 100);
+    }
+    lst.sort();
+    assert(lst.size() == 1000);
+    assert(std::is_sorted(lst.begin(), lst.end()));
+    // tail is still the last node
+    lst.push_back(1000);
+    assert(std::is_sorted(lst.begin(), lst.end()));
+
+    TSingleLinkedList<TKeyed> keyed;
+    for (int i = 0; i < 1000; ++i) {
+        keyed.push_back(TKeyed{ std::rand() % 10, i });
+    }
+    keyed.sort();
+    for (auto it = keyed.begin(), next = ++keyed.begin(); next != keyed.end(); ++it, ++next) {
+        assert(it->key < next->key || (it->key == next->key && it->order < next->order));
+    }
+}
+
+void sort_list(TSingleLinkedList<int>& lst)
+{
+    lst.sort();
+}
+
+typedef TSingleLinkedList<TSingleLinkedList<int>> RunList;
+
+// merges the runs pairwise, round by round, until one is left
+void merge_by_copy(RunList& runs)
+{
+    while (runs.size() > 1) {
+        TSingleLinkedList<int> first = runs.pop_front();
+        TSingleLinkedList<int> second = runs.pop_front();
+        TSingleLinkedList<int> merged;
+        merged.reserve(first.size() + second.size());
+        Nstd::merge(first.begin(), first.end(), second.begin(), second.end(), merged.begin());
+        runs.push_back(std::move(merged));
+    }
+}
+
+void merge_by_relinking(RunList& runs)
+{
+    while (runs.size() > 1) {
+        TSingleLinkedList<int> first = runs.pop_front();
+        first.merge(runs.pop_front());
+        runs.push_back(std::move(first));
+    }
+}
+
+void measure_merge_runs()
+{
+    const int n_runs = 4096, run_length = 256;
+    RunList runs;
+    for (int r = 0; r < n_runs; ++r) {
+        TSingleLinkedList<int> run;
+        for (int i = 0; i < run_length; ++i) {
+            run.push_back(std::rand());
+        }
+        run.sort();
+        runs.push_back(std::move(run));
+    }
+    RunList copy(runs);
+    std::cout << "Merging " << n_runs << " sorted runs of " << run_length << " ints: Nstd::merge "
+              << Nstd::measure<>::execution(merge_by_copy, copy) << " us";
+    std::cout << ", merge(&&) " << Nstd::measure<>::execution(merge_by_relinking, runs) << " us" << std::endl;
+    assert(std::equal(runs.begin()->begin(), runs.begin()->end(), copy.begin()->begin()));
+}
+
+void measure_sort()
+{
+    const int n = 2000000;
+    TSingleLinkedList<int> lst;
+    for (int i = 0; i < n; ++i) {
+        lst.push_back(std::rand());
+    }
+    TSingleLinkedList<int> sorted;
+    std::cout << "Sorting a list of " << n << " ints: sorted() "
+              << Nstd::measure<>::execution([&] () { sorted = lst.sorted(); }) << " us";
+    std::cout << ", sort() in place " << Nstd::measure<>::execution(sort_list, lst) << " us" << std::endl;
+    assert(std::is_sorted(lst.begin(), lst.end()));
+    assert(sorted.size() == lst.size() && std::equal(sorted.begin(), sorted.end(), lst.begin()));
+}
+
 void test_insert()
 {
     typedef TSingleLinkedList<int> IntListType;
@@ -230,6 +452,192 @@ void test_insert()
     assert(std::equal(lst.begin(), lst.end(), test_lst.begin()));
 }
 
+void test_arena()
+{
+    typedef TSingleLinkedList<int, TArenaAllocator<int>> IntListType;
+
+    IntListType lst({1,2,3,4,5});
+    lst.push_front(0);
+    lst.push_back(6);
+    lst.insert(++lst.begin(), 10);
+    IntListType check_list({0,10,1,2,3,4,5,6});
+    assert(lst.size() == 8);
+    assert(std::equal(lst.begin(), lst.end(), check_list.begin()));
+
+    // blocks given back by pop_front are reused
+    assert(lst.pop_front() == 0);
+    lst.push_front(0);
+    assert(std::equal(lst.begin(), lst.end(), check_list.begin()));
+
+    // a copy gets an arena of its own and survives the original
+    IntListType* original = new IntListType(lst);
+    IntListType copy(*original);
+    delete original;
+    assert(std::equal(copy.begin(), copy.end(), check_list.begin()));
+
+    // a move takes the slabs along
+    IntListType moved(std::move(copy));
+    assert(copy.size() == 0);
+    assert(moved.size() == 8);
+    assert(std::equal(moved.begin(), moved.end(), check_list.begin()));
+    copy = std::move(moved);
+    assert(std::equal(copy.begin(), copy.end(), check_list.begin()));
+
+    copy.clear();
+    assert(copy.size() == 0);
+    assert(copy.begin() == copy.end());
+    copy.push_back(42);
+    assert(copy.pop_front() == 42);
+
+    // values with destructors are still destroyed
+    TSingleLinkedList<std::string, TArenaAllocator<std::string>> strings;
+    for (int i = 0; i < 1000; ++i) {
+        strings.push_back(std::string(100, 'a' + i % 26));
+    }
+    assert(strings.size() == 1000);
+    assert(*strings.begin() == std::string(100, 'a'));
+    strings.clear();
+    assert(strings.size() == 0);
+}
+
+void test_unrolled()
+{
+    typedef TUnrolledLinkedList<int, 4> IntListType;
+
+    IntListType lst;
+    for (int i = 0; i < 10; ++i) {
+        lst.push_back(i);
+    }
+    lst.push_front(-1);
+    assert(lst.size() == 11);
+    IntListType check_list({-1,0,1,2,3,4,5,6,7,8,9});
+    assert(std::equal(lst.begin(), lst.end(), check_list.begin()));
+
+    // insert in front of every value, splitting full nodes on the way
+    for (IntListType::ForwardIterator it = lst.begin(); it != lst.end(); ++it) {
+        int v = *it;
+        lst.insert(it, 100 + v);
+        assert(*it == 100 + v);
+        ++it;
+        assert(*it == v);
+    }
+    assert(lst.size() == 22);
+    IntListType::ForwardIterator it = lst.begin();
+    for (int i = -1; i < 10; ++i) {
+        assert(*it++ == 100 + i);
+        assert(*it++ == i);
+    }
+    assert(it == lst.end());
+
+    IntListType copy(lst);
+    for (int i = -1; i < 10; ++i) {
+        assert(lst.pop_front() == 100 + i);
+        assert(lst.pop_front() == i);
+    }
+    assert(lst.size() == 0);
+    assert(lst.begin() == lst.end());
+    lst.push_back(7);
+    assert(lst.pop_front() == 7);
+
+    IntListType moved(std::move(copy));
+    assert(copy.size() == 0);
+    assert(moved.size() == 22);
+    lst = moved;
+    assert(std::equal(lst.begin(), lst.end(), moved.begin()));
+
+    TUnrolledLinkedList<std::string, 3, TArenaAllocator<std::string>> strings({"b", "d"});
+    strings.insert(strings.begin(), "a");
+    strings.insert(++++strings.begin(), "c");
+    strings.push_back("e");
+    const char* expected[] = {"a", "b", "c", "d", "e"};
+    assert(std::equal(strings.begin(), strings.end(), expected));
+    assert(strings.pop_front() == "a");
+    std::string f = "f";
+    strings.push_back(std::move(f));
+    strings.emplace_front(3, 'z');
+    assert(*strings.begin() == "zzz");
+    strings.clear();
+    assert(strings.size() == 0);
+}
+
+template<class List>
+int sum_values(const List& lst)
+{
+    int sum = 0;
+    for (int v : lst) {
+        sum += v;
+    }
+    return sum;
+}
+
+template<class List>
+void iterate_and_copy(const List& lst, List& dst, int times)
+{
+    int sum = 0;
+    for (int i = 0; i < times; ++i) {
+        sum += sum_values(lst);
+        Nstd::copy(lst.begin(), lst.end(), dst.begin());
+    }
+    assert(sum != 1);
+}
+
+// inserts a value in front of every other value
+template<class List>
+void insert_between(List& lst, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        lst.push_back(i);
+    }
+    for (auto it = lst.begin(); it != lst.end(); ++it, ++it) {
+        lst.insert(it, -1);
+    }
+    assert(lst.size() == 2 * n);
+}
+
+template<class List>
+void measure_list(const char* name, int n)
+{
+    List lst, dst;
+    for (int i = 0; i < n; ++i) {
+        lst.push_back(i);
+    }
+    dst.reserve(n);
+    std::cout << "  " << name << ": iterate and copy 10 times "
+              << Nstd::measure<>::execution(iterate_and_copy<List>, lst, dst, 10) << " us";
+    List grown;
+    std::cout << ", insert between values " << Nstd::measure<>::execution(insert_between<List>, grown, n) << " us" << std::endl;
+}
+
+void measure_unrolled()
+{
+    const int n = 1000000;
+    std::cout << "Lists of " << n << " ints" << std::endl;
+    measure_list<TSingleLinkedList<int>>("TSingleLinkedList", n);
+    measure_list<TUnrolledLinkedList<int>>("TUnrolledLinkedList", n);
+}
+
+template<class List>
+void build_and_destroy(int n)
+{
+    List lst;
+    for (int i = 0; i < n; ++i) {
+        lst.push_back(i);
+    }
+    assert(lst.size() == n);
+}
+
+void measure_build_and_destroy()
+{
+    const int n = 10000000;
+    std::cout << "Build and destroy a list of " << n << " ints" << std::endl;
+    std::cout << "  std::allocator: "
+              << Nstd::measure<>::execution(build_and_destroy<TSingleLinkedList<int>>, n) << std::endl;
+    std::cout << "  TArenaAllocator: "
+              << Nstd::measure<>::execution(build_and_destroy<TSingleLinkedList<int, TArenaAllocator<int>>>, n) << std::endl;
+    std::cout << "  TPoolAllocator: "
+              << Nstd::measure<>::execution(build_and_destroy<TSingleLinkedList<int, TPoolAllocator<int>>>, n) << std::endl;
+}
+
 int main(int argc, char* argv[])
 {
     test_size();
@@ -239,5 +647,14 @@ int main(int argc, char* argv[])
     test_copy_move();
     test_sorted();
     test_insert();
+    test_move_values();
+    test_splice();
+    test_sort();
+    test_arena();
+    test_unrolled();
+    measure_build_and_destroy();
+    measure_unrolled();
+    measure_sort();
+    measure_merge_runs();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,385 @@
+#pragma once
+#include <assert.h>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <debug_new.h>
+#include "arena_allocator.h"
+
+// As many values as fit in a 64-byte node next to the link and the count,
+// but at least two, so that a full node can always be split.
+template<class Value>
+struct unrolled_list_capacity {
+    static const int cache_line = 64;
+    static const int fitting = (cache_line - sizeof(void*) - sizeof(int)) / sizeof(Value);
+    static const int value = fitting < 2 ? 2 : fitting;
+};
+
+// Singly linked list that keeps up to Capacity values per node, packed at
+// the front of the node. It has the interface of TSingleLinkedList, so it
+// can stand in for it; walking it touches one node per Capacity values.
+// Inserting into a node shifts the values behind the insertion point and
+// invalidates the iterators into that node, except the one inserted at.
+template<class Value, int Capacity = unrolled_list_capacity<Value>::value,
+         class Alloc = std::allocator<Value>>
+class TUnrolledLinkedList {
+    static_assert(Capacity >= 2, "a node must hold at least two values");
+
+public:
+    class ForwardIterator;
+
+private:
+    class Node;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Node> NodeAlloc;
+    typedef std::allocator_traits<NodeAlloc> NodeAllocTraits;
+
+public:
+    TUnrolledLinkedList()
+    {
+        initialize();
+    }
+
+    explicit TUnrolledLinkedList(const Alloc& alloc) :
+        node_alloc( alloc )
+    {
+        initialize();
+    }
+
+    ~TUnrolledLinkedList()
+    {
+        clear();
+    }
+
+    TUnrolledLinkedList(std::initializer_list<Value> init)
+    {
+        initialize();
+        for (auto it = init.begin(); it != init.end(); ++it) {
+            push_back(*it);
+        }
+    }
+
+    TUnrolledLinkedList(const TUnrolledLinkedList& other) :
+        node_alloc( NodeAllocTraits::select_on_container_copy_construction(other.node_alloc) )
+    {
+        initialize();
+        *this = other;
+    }
+
+    TUnrolledLinkedList(TUnrolledLinkedList&& other) :
+        node_alloc( std::move(other.node_alloc) )
+    {
+        initialize();
+        std::swap(head, other.head);
+        std::swap(tail, other.tail);
+        std::swap(sz, other.sz);
+    }
+
+    void operator=(const TUnrolledLinkedList& other)
+    {
+        if (this == &other) {
+            return;
+        }
+        clear();
+        for (const Value& v : other) {
+            push_back(v);
+        }
+    }
+
+    void operator=(TUnrolledLinkedList&& other)
+    {
+        clear();
+        std::swap(node_alloc, other.node_alloc);
+        std::swap(head, other.head);
+        std::swap(tail, other.tail);
+        std::swap(sz, other.sz);
+    }
+
+    ForwardIterator begin() const
+    {
+        return ForwardIterator(head, 0);
+    }
+
+    ForwardIterator end() const
+    {
+        return ForwardIterator(0, 0);
+    }
+
+    void clear()
+    {
+        free_nodes(node_alloc);
+        initialize();
+    }
+
+    void push_front(const Value& v)
+    {
+        emplace_front(v);
+    }
+
+    void push_front(Value&& v)
+    {
+        emplace_front(std::move(v));
+    }
+
+    void push_back(const Value& v)
+    {
+        emplace_back(v);
+    }
+
+    void push_back(Value&& v)
+    {
+        emplace_back(std::move(v));
+    }
+
+    template<class... Args>
+    void emplace_front(Args&&... args)
+    {
+        if (head == 0 || head->count == Capacity) {
+            Node* node = create_node();
+            node->next = head;
+            head = node;
+            if (tail == 0) {
+                tail = node;
+            }
+        }
+        insert_at(head, 0, std::forward<Args>(args)...);
+        ++sz;
+    }
+
+    template<class... Args>
+    void emplace_back(Args&&... args)
+    {
+        if (tail == 0 || tail->count == Capacity) {
+            Node* node = create_node();
+            if (tail == 0) {
+                head = tail = node;
+            } else {
+                tail = tail->next = node;
+            }
+        }
+        NodeAllocTraits::construct(node_alloc, tail->at(tail->count), std::forward<Args>(args)...);
+        ++tail->count;
+        ++sz;
+    }
+
+    // Inserts v in front of the value it points to; it then points to v.
+    void insert(const ForwardIterator& it, const Value& v)
+    {
+        emplace(it, v);
+    }
+
+    void insert(const ForwardIterator& it, Value&& v)
+    {
+        emplace(it, std::move(v));
+    }
+
+    // Constructs a value in front of the one it points to, like insert.
+    template<class... Args>
+    void emplace(const ForwardIterator& it, Args&&... args)
+    {
+        assert(it.node != 0);
+        Node* node = it.node;
+        if (node->count == Capacity) {
+            // the values from split on move to a new node; split is never
+            // below it.index, so v still goes into this node
+            int split = it.index < Capacity / 2 ? Capacity / 2 : it.index;
+            Node* newnode = create_node();
+            for (int k = split; k < Capacity; ++k) {
+                NodeAllocTraits::construct(node_alloc, newnode->at(k - split), std::move(*node->at(k)));
+                NodeAllocTraits::destroy(node_alloc, node->at(k));
+            }
+            newnode->count = Capacity - split;
+            node->count = split;
+            newnode->next = node->next;
+            node->next = newnode;
+            if (tail == node) {
+                tail = newnode;
+            }
+        }
+        insert_at(node, it.index, std::forward<Args>(args)...);
+        ++sz;
+    }
+
+    Value pop_front()
+    {
+        assert(size());
+        assert(head != 0);
+        Value ret = std::move(*head->at(0));
+        for (int k = 1; k < head->count; ++k) {
+            *head->at(k - 1) = std::move(*head->at(k));
+        }
+        NodeAllocTraits::destroy(node_alloc, head->at(--head->count));
+        if (head->count == 0) {
+            Node* tmp = head;
+            head = head->next;
+            destroy_node(tmp);
+            if (head == 0) {
+                tail = 0;
+            }
+        }
+        --sz;
+        return ret;
+    }
+
+    void reserve(unsigned int n)
+    {
+        for(unsigned int i = 0; i < n; ++i) {
+            push_back(Value());
+        }
+    }
+
+    int size() const
+    {
+        return sz;
+    }
+
+public:
+    class ForwardIterator : public std::iterator<std::forward_iterator_tag, Value> {
+    friend class TUnrolledLinkedList;
+    public:
+        Value& operator*() const {
+            assert(node != 0);
+            return *node->at(index);
+        }
+
+        Value* operator->() const {
+            assert(node != 0);
+            return node->at(index);
+        }
+
+        ForwardIterator& operator++() // prefix
+        {
+            if (++index == node->count) {
+                node = node->next;
+                index = 0;
+            }
+            return *this;
+        }
+
+        ForwardIterator operator++(int) // postfix
+        {
+            ForwardIterator ret = ForwardIterator(*this);
+            ++*this;
+            return ret;
+        }
+
+        bool operator==(const ForwardIterator& other) const
+        {
+            return node == other.node && index == other.index;
+        }
+
+        bool operator!=(const ForwardIterator& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        ForwardIterator(Node* _node, int _index) :
+            node( _node ),
+            index( _index )
+        {
+        }
+
+    private:
+        Node* node;
+        int index;
+
+    };
+
+private:
+    NodeAlloc node_alloc;
+    Node* head;
+    Node* tail;
+    int sz;
+
+    void initialize()
+    {
+        head = 0;
+        tail = 0;
+        sz = 0;
+    }
+
+    Node* create_node()
+    {
+        Node* node = NodeAllocTraits::allocate(node_alloc, 1);
+        NodeAllocTraits::construct(node_alloc, node);
+        return node;
+    }
+
+    void destroy_node(Node* node)
+    {
+        NodeAllocTraits::destroy(node_alloc, node);
+        NodeAllocTraits::deallocate(node_alloc, node, 1);
+    }
+
+    // node has room for one more value
+    template<class... Args>
+    void insert_at(Node* node, int index, Args&&... args)
+    {
+        assert(node->count < Capacity);
+        assert(index <= node->count);
+        if (index < node->count) {
+            NodeAllocTraits::construct(node_alloc, node->at(node->count), std::move(*node->at(node->count - 1)));
+            for (int k = node->count - 1; k > index; --k) {
+                *node->at(k) = std::move(*node->at(k - 1));
+            }
+            NodeAllocTraits::destroy(node_alloc, node->at(index));
+        }
+        NodeAllocTraits::construct(node_alloc, node->at(index), std::forward<Args>(args)...);
+        ++node->count;
+    }
+
+    void destroy_values(Node* node)
+    {
+        if (!std::is_trivially_destructible<Value>::value) {
+            for (int k = 0; k < node->count; ++k) {
+                NodeAllocTraits::destroy(node_alloc, node->at(k));
+            }
+        }
+    }
+
+    template<class AnyAlloc>
+    void free_nodes(AnyAlloc&)
+    {
+        while (head != 0) {
+            Node* next = head->next;
+            destroy_values(head);
+            destroy_node(head);
+            head = next;
+        }
+    }
+
+    // the list is the only user of its arena, so the slabs go back whole
+    template<class T>
+    void free_nodes(TArenaAllocator<T>& arena)
+    {
+        for (Node* node = head; node != 0; node = node->next) {
+            destroy_values(node);
+        }
+        arena.release();
+    }
+
+private:
+    class Node {
+    friend class TUnrolledLinkedList;
+    friend class TUnrolledLinkedList::ForwardIterator;
+
+    public:
+        // public for std::allocator_traits::construct, Node itself is private
+        Node() :
+            next( 0 ),
+            count( 0 )
+        {
+        }
+
+    private:
+        Node* next;
+        int count;
+        // values [0, count) are alive
+        typename std::aligned_storage<sizeof(Value), alignof(Value)>::type slots[Capacity];
+
+        Value* at(int index)
+        {
+            return reinterpret_cast<Value*>(&slots[index]);
+        }
+    };
+};
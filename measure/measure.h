@@ -1,4 +1,5 @@
 #include <chrono>
+#include <utility>
 
 namespace Nstd {
 
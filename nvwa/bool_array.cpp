@@ -209,13 +209,10 @@ bool_array::bool_array(const void* ptr, size_type size)
  * @throw bad_alloc  memory is insufficient
  */
 bool_array::bool_array(const bool_array& rhs)
+    : _M_byte_ptr(NULL), _M_length(0)
 {
     if (rhs.size() == 0)
-    {
-        _M_byte_ptr = NULL;
-        _M_length = 0;
         return;
-    }
     if (!create(rhs.size()))
         throw std::bad_alloc();
     memcpy(_M_byte_ptr, rhs._M_byte_ptr, (size_t)((_M_length - 1) / 8) + 1);
@@ -295,8 +295,8 @@ public:
      *             guarantee.
      */
     void swap(fc_queue& rhs)
-        _NOEXCEPT_(noexcept(swap(std::declval<allocator_type&>(),
-                                 std::declval<allocator_type&>())))
+        _NOEXCEPT_(noexcept(std::swap(std::declval<allocator_type&>(),
+                                      std::declval<allocator_type&>())))
     {
         using std::swap;
         swap(_M_alloc, rhs._M_alloc);
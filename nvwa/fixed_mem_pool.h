@@ -40,6 +40,10 @@
  *   at the end of the class (say, \c class \e _Cls) definitions.
  * - Optionally, specialize fixed_mem_pool::alignment to change the
  *   alignment value for this specific type.
+ * - Optionally, specialize fixed_mem_pool::lock_free to make allocate
+ *   and deallocate lock-free for this specific type.
+ * - Optionally, specialize fixed_mem_pool::growable to let the memory
+ *   pool grow by chaining more chunks when all blocks are allocated.
  * - Optionally, specialize fixed_mem_pool::bad_alloc_handler to change
  *   the behaviour when all memory blocks are allocated.
  * - Call fixed_mem_pool<_Cls>::initialize at the beginning of the
@@ -55,8 +59,10 @@
 #ifndef NVWA_FIXED_MEM_POOL_H
 #define NVWA_FIXED_MEM_POOL_H
 
+#include <atomic>               // std::atomic
 #include <new>                  // std::bad_alloc
 #include <assert.h>             // assert
+#include <stdint.h>             // uintptr_t
 #include <stdlib.h>             // size_t/NULL
 #include "_nvwa.h"              // NVWA/NVWA_NAMESPACE_*
 #include "c++11.h"              // _NOEXCEPT
@@ -75,7 +81,8 @@ NVWA_NAMESPACE_BEGIN
 
 /**
  * Class template to manipulate a fixed-size memory pool.  Please notice
- * that only allocate and deallocate are protected by a lock.
+ * that only allocate and deallocate are protected by a lock, or are
+ * lock-free if fixed_mem_pool::lock_free is specialized so.
  *
  * @param _Tp  class to use the fixed_mem_pool
  */
@@ -92,6 +99,26 @@ public:
     {
         static const size_t value = MEM_POOL_ALIGNMENT;
     };
+    /**
+     * Specializable struct to choose a lock-free free list, a Treiber
+     * stack whose head is swapped together with a word-sized tag against
+     * the ABA problem, over the locked one.  It needs a double-width
+     * compare-and-swap (\c cmpxchg16b on x86-64), which GCC takes from
+     * libatomic.
+     */
+    struct lock_free
+    {
+        static const bool value = false;
+    };
+    /**
+     * Specializable struct to let the memory pool grow when it runs out
+     * of blocks.  Each new chunk holds as many blocks as all the chunks
+     * before it, so the number of chunks stays logarithmic.
+     */
+    struct growable
+    {
+        static const bool value = false;
+    };
     /**
      * Struct to calculate the block size based on the (specializable)
      * alignment value.
@@ -107,26 +134,63 @@ public:
     static bool   initialize(size_t size);
     static int    deinitialize();
     static int    get_alloc_count();
+    static size_t get_block_count();
     static bool   is_initialized();
 protected:
     static bool   bad_alloc_handler();
 private:
+    /** Header at the start of every chunk of memory blocks. */
+    struct _Chunk_header
+    {
+        void*  _M_next;         ///< Pointer to the chunk allocated before
+        size_t _M_size;         ///< Size of the chunk in bytes
+    };
+    /**
+     * Head of the lock-free free list: the first available block and a
+     * tag changed by every push and pop, compared and swapped together.
+     */
+    struct _Tagged_ptr
+    {
+        void*     _M_ptr;       ///< Pointer to the first available block
+        uintptr_t _M_tag;       ///< Count of changes to the head
+    };
+    static bool   _S_add_chunk(size_t size, void*& first, void*& last);
+    static bool   _S_grow();
+    static bool   _S_grow_lock_free();
+    static void*  _S_allocate_lock_free();
+    static void   _S_deallocate_lock_free(void*);
+    static _Tagged_ptr _S_tagged(void* ptr, uintptr_t tag);
+
     static void*  _S_mem_pool_ptr;
+    static size_t _S_block_cnt;
     static void*  _S_first_avail_ptr;
-    static int    _S_alloc_cnt;
+    static std::atomic<_Tagged_ptr> _S_tagged_head;
+    static std::atomic<int> _S_alloc_cnt;
 };
 
-/** Pointer to the allocated chunk of memory. */
+/** Pointer to the last allocated chunk of memory. */
 template <class _Tp>
 void* fixed_mem_pool<_Tp>::_S_mem_pool_ptr = NULL;
 
+/** Count of memory blocks in all chunks. */
+template <class _Tp>
+size_t fixed_mem_pool<_Tp>::_S_block_cnt = 0;
+
 /** Pointer to the first available memory block. */
 template <class _Tp>
 void* fixed_mem_pool<_Tp>::_S_first_avail_ptr = NULL;
 
+/**
+ * Tagged pointer to the first available memory block (lock-free).  It is
+ * zero-initialized, as a static object.
+ */
+template <class _Tp>
+std::atomic<typename fixed_mem_pool<_Tp>::_Tagged_ptr>
+        fixed_mem_pool<_Tp>::_S_tagged_head;
+
 /** Count of allocations. */
 template <class _Tp>
-int   fixed_mem_pool<_Tp>::_S_alloc_cnt = 0;
+std::atomic<int> fixed_mem_pool<_Tp>::_S_alloc_cnt(0);
 
 /**
  * Allocates a memory block from the memory pool.
@@ -136,17 +200,21 @@ int   fixed_mem_pool<_Tp>::_S_alloc_cnt = 0;
 template <class _Tp>
 inline void* fixed_mem_pool<_Tp>::allocate()
 {
+    if (lock_free::value)
+        return _S_allocate_lock_free();
     lock guard;
     for (;;)
     {
         if (void* result = _S_first_avail_ptr)
         {
             _S_first_avail_ptr = *(void**)_S_first_avail_ptr;
-            ++_S_alloc_cnt;
+            // Only changed under the lock, so no atomic increment
+            _S_alloc_cnt.store(_S_alloc_cnt.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
             return result;
         }
         else
-            if (!bad_alloc_handler())
+            if (!(growable::value && _S_grow()) && !bad_alloc_handler())
                 return NULL;
     }
 }
@@ -161,9 +229,15 @@ inline void fixed_mem_pool<_Tp>::deallocate(void* block_ptr)
 {
     if (block_ptr == NULL)
         return;
+    if (lock_free::value)
+    {
+        _S_deallocate_lock_free(block_ptr);
+        return;
+    }
     lock guard;
-    assert(_S_alloc_cnt != 0);
-    --_S_alloc_cnt;
+    assert(_S_alloc_cnt.load(std::memory_order_relaxed) != 0);
+    _S_alloc_cnt.store(_S_alloc_cnt.load(std::memory_order_relaxed) - 1,
+                       std::memory_order_relaxed);
     *(void**)block_ptr = _S_first_avail_ptr;
     _S_first_avail_ptr = block_ptr;
 }
@@ -183,20 +257,16 @@ bool fixed_mem_pool<_Tp>::initialize(size_t size)
                   Alignment_must_be_power_of_two);
     STATIC_ASSERT(block_size::value >= sizeof(void*),
                   Alignment_too_small);
+    STATIC_ASSERT(sizeof(_Tagged_ptr) == 2 * sizeof(void*),
+                  Tagged_pointer_must_be_double_width);
     assert(!is_initialized());
     assert(size > 0);
-    _S_mem_pool_ptr = mem_pool_base::alloc_sys(size * block_size::value);
-    _S_first_avail_ptr = _S_mem_pool_ptr;
-    if (_S_mem_pool_ptr == NULL)
+    void* first;
+    void* last;
+    if (!_S_add_chunk(size, first, last))
         return false;
-    char* block = (char*)_S_mem_pool_ptr;
-    while (--size != 0)
-    {
-        char* next = block + block_size::value;
-        *(void**)block = next;
-        block = next;
-    }
-    *(void**)block = NULL;
+    _S_first_avail_ptr = first;
+    _S_tagged_head.store(_S_tagged(first, 0), std::memory_order_release);
     return true;
 }
 
@@ -210,12 +280,18 @@ bool fixed_mem_pool<_Tp>::initialize(size_t size)
 template <class _Tp>
 int fixed_mem_pool<_Tp>::deinitialize()
 {
-    if (_S_alloc_cnt != 0)
-        return _S_alloc_cnt;
+    if (int count = get_alloc_count())
+        return count;
     assert(is_initialized());
-    mem_pool_base::dealloc_sys(_S_mem_pool_ptr);
-    _S_mem_pool_ptr = NULL;
+    while (_S_mem_pool_ptr)
+    {
+        _Chunk_header* chunk = (_Chunk_header*)_S_mem_pool_ptr;
+        _S_mem_pool_ptr = chunk->_M_next;
+        mem_pool_base::dealloc_sys_chunk(chunk, chunk->_M_size);
+    }
+    _S_block_cnt = 0;
     _S_first_avail_ptr = NULL;
+    _S_tagged_head.store(_S_tagged(NULL, 0), std::memory_order_relaxed);
     return 0;
 }
 
@@ -227,7 +303,20 @@ int fixed_mem_pool<_Tp>::deinitialize()
 template <class _Tp>
 inline int fixed_mem_pool<_Tp>::get_alloc_count()
 {
-    return _S_alloc_cnt;
+    return _S_alloc_cnt.load(std::memory_order_relaxed);
+}
+
+/**
+ * Gets the number of memory blocks in the memory pool, allocated or
+ * not.  It grows only if fixed_mem_pool::growable is specialized so.
+ *
+ * @return  the number of memory blocks in all chunks
+ */
+template <class _Tp>
+inline size_t fixed_mem_pool<_Tp>::get_block_count()
+{
+    lock guard;
+    return _S_block_cnt;
 }
 
 /**
@@ -255,6 +344,168 @@ bool fixed_mem_pool<_Tp>::bad_alloc_handler()
     return false;
 }
 
+/**
+ * Pops a memory block off the lock-free free list.  The tag in the head
+ * changes with every push and pop, so a compare-and-swap from a head
+ * read before the block was taken and given back by other threads
+ * fails.  The tag is as wide as a pointer: on 64-bit platforms it would
+ * take 2^64 changes while one thread is held up to wrap it around.
+ *
+ * @return  pointer to the allocated memory block
+ */
+template <class _Tp>
+void* fixed_mem_pool<_Tp>::_S_allocate_lock_free()
+{
+    _Tagged_ptr head = _S_tagged_head.load(std::memory_order_acquire);
+    for (;;)
+    {
+        void* result = head._M_ptr;
+        if (result == NULL)
+        {
+            if (!_S_grow_lock_free() && !bad_alloc_handler())
+                return NULL;
+            head = _S_tagged_head.load(std::memory_order_acquire);
+            continue;
+        }
+        // The block may be taken and written to by another thread in the
+        // meantime; the next pointer read is then stale, but the memory
+        // stays in the pool and the compare-and-swap below fails.
+        void* next = *(void* volatile*)result;
+        _Tagged_ptr new_head = _S_tagged(next, head._M_tag + 1);
+        if (_S_tagged_head.compare_exchange_weak(head, new_head,
+                                                 std::memory_order_acquire,
+                                                 std::memory_order_acquire))
+        {
+            _S_alloc_cnt.fetch_add(1, std::memory_order_relaxed);
+            return result;
+        }
+    }
+}
+
+/**
+ * Pushes a memory block onto the lock-free free list.
+ *
+ * @param block_ptr  pointer to the memory block to return
+ */
+template <class _Tp>
+void fixed_mem_pool<_Tp>::_S_deallocate_lock_free(void* block_ptr)
+{
+    assert(_S_alloc_cnt.load(std::memory_order_relaxed) != 0);
+    _S_alloc_cnt.fetch_sub(1, std::memory_order_relaxed);
+    _Tagged_ptr head = _S_tagged_head.load(std::memory_order_relaxed);
+    _Tagged_ptr new_head;
+    do
+    {
+        *(void**)block_ptr = head._M_ptr;
+        new_head = _S_tagged(block_ptr, head._M_tag + 1);
+    }
+    while (!_S_tagged_head.compare_exchange_weak(head, new_head,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+}
+
+/**
+ * Allocates a chunk of at least \a size memory blocks, links its blocks
+ * into a list and puts the chunk into the chain of chunks.  Large chunks
+ * are mapped from the system in huge pages if it supports them (see
+ * mem_pool_base::alloc_sys_chunk), and the blocks then fill all of it.
+ * Called at initialization or with the lock held.
+ *
+ * @param size   minimum number of memory blocks in the chunk
+ * @param first  receives the first block of the list
+ * @param last   receives the last block of the list
+ * @return       \c true if successful; \c false if memory insufficient
+ */
+template <class _Tp>
+bool fixed_mem_pool<_Tp>::_S_add_chunk(size_t size, void*& first,
+                                       void*& last)
+{
+    size_t bytes = sizeof(_Chunk_header) + alignment::value - 1
+                 + size * block_size::value;
+    _Chunk_header* chunk =
+            (_Chunk_header*)mem_pool_base::alloc_sys_chunk(bytes);
+    if (chunk == NULL)
+        return false;
+    chunk->_M_next = _S_mem_pool_ptr;
+    chunk->_M_size = bytes;
+    _S_mem_pool_ptr = chunk;
+    // The system may align the chunk less strictly than the blocks
+    char* block = (char*)(((uintptr_t)(chunk + 1) + alignment::value - 1)
+                          & ~(uintptr_t)(alignment::value - 1));
+    size = ((char*)chunk + bytes - block) / block_size::value;
+    _S_block_cnt += size;
+    first = block;
+    while (--size != 0)
+    {
+        char* next = block + block_size::value;
+        *(void**)block = next;
+        block = next;
+    }
+    *(void**)block = NULL;
+    last = block;
+    return true;
+}
+
+/**
+ * Adds a chunk as large as all existing ones to the locked free list.
+ * Called with the lock held.
+ *
+ * @return  \c true if successful; \c false if memory insufficient
+ */
+template <class _Tp>
+bool fixed_mem_pool<_Tp>::_S_grow()
+{
+    void* first;
+    void* last;
+    if (!_S_add_chunk(_S_block_cnt, first, last))
+        return false;
+    *(void**)last = _S_first_avail_ptr;
+    _S_first_avail_ptr = first;
+    return true;
+}
+
+/**
+ * Adds a chunk as large as all existing ones to the lock-free free
+ * list, unless the pool is not growable.  Growing is rare, so it takes
+ * the lock to keep threads that find the list empty at the same time
+ * from all adding chunks; only the first one does.
+ *
+ * @return  \c true if there may be free blocks now; \c false otherwise
+ */
+template <class _Tp>
+bool fixed_mem_pool<_Tp>::_S_grow_lock_free()
+{
+    if (!growable::value)
+        return false;
+    lock guard;
+    _Tagged_ptr head = _S_tagged_head.load(std::memory_order_acquire);
+    if (head._M_ptr != NULL)
+        return true;
+    void* first;
+    void* last;
+    if (!_S_add_chunk(_S_block_cnt, first, last))
+        return false;
+    _Tagged_ptr new_head;
+    do
+    {
+        *(void**)last = head._M_ptr;
+        new_head = _S_tagged(first, head._M_tag + 1);
+    }
+    while (!_S_tagged_head.compare_exchange_weak(head, new_head,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+    return true;
+}
+
+/** Makes a head of the lock-free free list from a pointer and a tag. */
+template <class _Tp>
+inline typename fixed_mem_pool<_Tp>::_Tagged_ptr
+fixed_mem_pool<_Tp>::_S_tagged(void* ptr, uintptr_t tag)
+{
+    _Tagged_ptr result = { ptr, tag };
+    return result;
+}
+
 NVWA_NAMESPACE_END
 
 /**
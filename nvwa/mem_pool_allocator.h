@@ -0,0 +1,162 @@
+// -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*-
+// vim:tabstop=4:shiftwidth=4:expandtab:
+
+/**
+ * @file  mem_pool_allocator.h
+ *
+ * Standard allocator over the `static' memory pools.  Unlike the
+ * DECLARE_STATIC_MEM_POOL macros, which fix the allocation of a class,
+ * it lets each container choose the pools through its allocator
+ * parameter.
+ */
+
+#ifndef NVWA_MEM_POOL_ALLOCATOR_H
+#define NVWA_MEM_POOL_ALLOCATOR_H
+
+#include <memory>               // std::allocator
+#include <new>                  // std::bad_alloc
+#include <type_traits>          // std::integral_constant/true_type/...
+#include <stddef.h>             // size_t/ptrdiff_t
+#include "_nvwa.h"              // NVWA_NAMESPACE_*
+#include "static_mem_pool.h"    // nvwa::static_mem_pool
+
+NVWA_NAMESPACE_BEGIN
+
+/**
+ * Defines the largest object size served from the memory pools.
+ */
+#ifndef POOL_ALLOCATOR_MAX_SIZE
+#define POOL_ALLOCATOR_MAX_SIZE 256
+#endif
+
+/**
+ * Struct to calculate the size class of objects of \a _Sz bytes: the
+ * size rounded up to 8 bytes up to 64, to 16 bytes up to 128 and to 32
+ * bytes beyond.  Objects of one size class share a static_mem_pool.
+ *
+ * @param _Sz  size of objects in bytes
+ */
+template <size_t _Sz>
+struct pool_size_class
+{
+    static const size_t granularity = _Sz <= 64 ? 8 : _Sz <= 128 ? 16 : 32;
+    static const size_t value =
+        (_Sz + granularity - 1) & ~(granularity - 1);
+    static const bool pooled = _Sz <= POOL_ALLOCATOR_MAX_SIZE;
+};
+
+/**
+ * Allocator meeting the C++11 allocator requirements.  Single objects of
+ * up to #POOL_ALLOCATOR_MAX_SIZE bytes come from the static_mem_pool of
+ * their size class and go back to it, so a block freed by one container
+ * is reused by the next one, whatever its type.  Arrays and larger
+ * objects go to \c std::allocator.  The allocator is stateless and all
+ * instances compare equal.
+ *
+ * @param _Tp  type of objects to allocate
+ */
+template <class _Tp>
+class pool_allocator
+{
+public:
+    typedef _Tp                 value_type;
+    typedef _Tp*                pointer;
+    typedef const _Tp*          const_pointer;
+    typedef _Tp&                reference;
+    typedef const _Tp&          const_reference;
+    typedef size_t              size_type;
+    typedef ptrdiff_t           difference_type;
+
+    /**
+     * Pool for single objects, if they are small enough.  It is not
+     * instantiated (and so never created) for larger objects.
+     */
+    typedef static_mem_pool<pool_size_class<sizeof(_Tp)>::value> pool_type;
+
+    template <class _Up>
+    struct rebind
+    {
+        typedef pool_allocator<_Up> other;
+    };
+
+    pool_allocator() _NOEXCEPT
+    {
+    }
+    template <class _Up>
+    pool_allocator(const pool_allocator<_Up>&) _NOEXCEPT
+    {
+    }
+
+    /**
+     * Allocates memory for \a n objects.
+     *
+     * @param n  number of objects
+     * @return   pointer to the allocated memory
+     * @throw    std::bad_alloc if memory is insufficient
+     */
+    _Tp* allocate(size_type n)
+    {
+        return _M_allocate(n, _Pooled());
+    }
+    /**
+     * Deallocates memory allocated by allocate.
+     *
+     * @param ptr  pointer to the memory
+     * @param n    number of objects, as passed to allocate
+     */
+    void deallocate(_Tp* ptr, size_type n)
+    {
+        _M_deallocate(ptr, n, _Pooled());
+    }
+
+private:
+    /**
+     * Tag type to choose the allocation path at compile time, so that
+     * the pool is only used for objects that fit.
+     */
+    typedef std::integral_constant<bool,
+                                   pool_size_class<sizeof(_Tp)>::pooled>
+            _Pooled;
+
+    _Tp* _M_allocate(size_type n, std::true_type)
+    {
+        if (n != 1)
+            return std::allocator<_Tp>().allocate(n);
+        if (void* ptr = pool_type::instance_known().allocate())
+            return static_cast<_Tp*>(ptr);
+        throw std::bad_alloc();
+    }
+    _Tp* _M_allocate(size_type n, std::false_type)
+    {
+        return std::allocator<_Tp>().allocate(n);
+    }
+    void _M_deallocate(_Tp* ptr, size_type n, std::true_type)
+    {
+        if (n == 1)
+            pool_type::instance_known().deallocate(ptr);
+        else
+            std::allocator<_Tp>().deallocate(ptr, n);
+    }
+    void _M_deallocate(_Tp* ptr, size_type n, std::false_type)
+    {
+        std::allocator<_Tp>().deallocate(ptr, n);
+    }
+};
+
+template <class _Tp, class _Up>
+inline bool operator==(const pool_allocator<_Tp>&,
+                       const pool_allocator<_Up>&)
+{
+    return true;
+}
+
+template <class _Tp, class _Up>
+inline bool operator!=(const pool_allocator<_Tp>&,
+                       const pool_allocator<_Up>&)
+{
+    return false;
+}
+
+NVWA_NAMESPACE_END
+
+#endif // NVWA_MEM_POOL_ALLOCATOR_H
@@ -40,6 +40,11 @@
 #include <new>                  // std::bad_alloc
 #endif
 
+#if defined(__linux__)
+#include <sys/mman.h>           // mmap/munmap/madvise
+#include <stdint.h>             // uintptr_t
+#endif
+
 #include "_nvwa.h"              // NVWA_NAMESPACE_*
 #include "mem_pool_base.h"      // nvwa::mem_pool_base
 
@@ -54,6 +59,11 @@ NVWA_NAMESPACE_BEGIN
 #   define _MEM_POOL_DEALLOCATE(_Ptr) ::operator delete(_Ptr)
 # endif
 
+/* Defines the size of huge pages to back large chunks with */
+# if defined(__linux__) && !defined(_MEM_POOL_NO_HUGE_PAGES)
+#   define _MEM_POOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+# endif
+
 /**
  * @fn void mem_pool_base::recycle()
  *
@@ -68,6 +78,37 @@ mem_pool_base::~mem_pool_base()
 {
 }
 
+/**
+ * Returns the free memory blocks cached by the calling thread to the
+ * pool.  The base version caches nothing.
+ */
+void mem_pool_base::release_thread_cache()
+{
+}
+
+/**
+ * Frees free memory blocks above the high-water mark of the pool.  The
+ * base version has nothing to trim.
+ *
+ * @param max_blocks  maximum number of memory blocks to free
+ * @return            number of memory blocks freed
+ */
+size_t mem_pool_base::trim(size_t /*max_blocks*/)
+{
+    return 0;
+}
+
+/**
+ * Gets the statistics of the pool.  The base version reports nothing.
+ *
+ * @return  the statistics of the pool
+ */
+mem_pool_stats mem_pool_base::get_stats() const
+{
+    mem_pool_stats stats = { 0, 0, 0, 0, 0 };
+    return stats;
+}
+
 /**
  * Allocates memory from the run-time system.
  *
@@ -90,4 +131,63 @@ void mem_pool_base::dealloc_sys(void* ptr)
     _MEM_POOL_DEALLOCATE(ptr);
 }
 
+/**
+ * Allocates a large chunk of memory from the run-time system.  A chunk
+ * of a huge page or more is rounded up to whole huge pages and mapped
+ * at a huge page boundary, with a hint to back it with huge pages, so
+ * that the blocks in it take fewer TLB entries; smaller chunks come
+ * from alloc_sys.
+ *
+ * @param size  size of the memory to allocate in bytes; receives the
+ *              size actually allocated
+ * @return      pointer to allocated memory block if successful; or
+ *              \c NULL if memory allocation fails
+ */
+void* mem_pool_base::alloc_sys_chunk(size_t& size)
+{
+#ifdef _MEM_POOL_HUGE_PAGE_SIZE
+    const size_t huge_page = _MEM_POOL_HUGE_PAGE_SIZE;
+    if (size >= huge_page)
+    {
+        size = (size + huge_page - 1) & ~(huge_page - 1);
+        // Maps one huge page more and trims it to an aligned range
+        char* mapped = (char*)mmap(NULL, size + huge_page,
+                                   PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED)
+            return NULL;
+        char* aligned = (char*)(((uintptr_t)mapped + huge_page - 1)
+                                & ~(uintptr_t)(huge_page - 1));
+        if (aligned != mapped)
+            munmap(mapped, aligned - mapped);
+        if (aligned + size != mapped + size + huge_page)
+            munmap(aligned + size, mapped + huge_page - aligned);
+#   ifdef MADV_HUGEPAGE
+        madvise(aligned, size, MADV_HUGEPAGE);
+#   endif
+        return aligned;
+    }
+#endif
+    return alloc_sys(size);
+}
+
+/**
+ * Frees a chunk of memory allocated by alloc_sys_chunk.
+ *
+ * @param ptr   pointer to the chunk
+ * @param size  size of the chunk as given back by alloc_sys_chunk
+ */
+void mem_pool_base::dealloc_sys_chunk(void* ptr, size_t size)
+{
+#ifdef _MEM_POOL_HUGE_PAGE_SIZE
+    if (size >= _MEM_POOL_HUGE_PAGE_SIZE)
+    {
+        munmap(ptr, size);
+        return;
+    }
+#endif
+    (void)size;
+    dealloc_sys(ptr);
+}
+
 NVWA_NAMESPACE_END
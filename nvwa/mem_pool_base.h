@@ -42,6 +42,18 @@
 
 NVWA_NAMESPACE_BEGIN
 
+/**
+ * Statistics of a memory pool.
+ */
+struct mem_pool_stats
+{
+    size_t block_size;          ///< Size of the memory blocks in bytes
+    size_t free_blocks;         ///< Free blocks the pool keeps
+    size_t high_water_mark;     ///< Free blocks kept when trimming
+    size_t trims;               ///< Trim steps that freed blocks
+    size_t trimmed_blocks;      ///< Blocks freed by trimming
+};
+
 /**
  * Base class for memory pools.
  */
@@ -50,8 +62,13 @@ class mem_pool_base
 public:
     virtual ~mem_pool_base();
     virtual void recycle() = 0;
+    virtual void release_thread_cache();
+    virtual size_t trim(size_t max_blocks);
+    virtual mem_pool_stats get_stats() const;
     static void* alloc_sys(size_t size);
     static void dealloc_sys(void* ptr);
+    static void* alloc_sys_chunk(size_t& size);
+    static void dealloc_sys_chunk(void* ptr, size_t size);
 
     /** Structure to store the next available memory block. */
     struct _Block_list
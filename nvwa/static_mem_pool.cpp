@@ -35,13 +35,14 @@
  */
 
 #include <algorithm>            // std::for_each
+#include <chrono>               // std::chrono::steady_clock
 #include "_nvwa.h"              // NVWA_NAMESPACE_*
 #include "cont_ptr_utils.h"     // nvwa::delete_object
 #include "static_mem_pool.h"    // nvwa::static_mem_pool_set
 
 NVWA_NAMESPACE_BEGIN
 
-static_mem_pool_set::static_mem_pool_set()
+static_mem_pool_set::static_mem_pool_set() : _M_trim_next(0)
 {
     _STATIC_MEM_POOL_TRACE(false, "The static_mem_pool_set is created");
 }
@@ -84,6 +85,128 @@ void static_mem_pool_set::recycle()
     }
 }
 
+/**
+ * Returns the free memory blocks the calling thread caches in any of
+ * the static memory pools to the pools, where recycle and trim can
+ * reach them.  The caller should get the lock.
+ */
+void static_mem_pool_set::release_thread_caches()
+{
+    container_type::iterator end = _M_memory_pool_set.end();
+    for (container_type::iterator
+            i  = _M_memory_pool_set.begin();
+            i != end; ++i)
+    {
+        (*i)->release_thread_cache();
+    }
+}
+
+/**
+ * Trims the static memory pools incrementally: each step frees at most
+ * #STATIC_MEM_POOL_TRIM_STEP free memory blocks above the high-water mark
+ * of one pool, taking the pools in turn, and the steps stop when the
+ * time is up or no pool has blocks above its mark.  At least one step is
+ * made, so a zero time limit makes a single step.  It may be called
+ * periodically, say, from an idle loop or a timer thread, to keep the
+ * memory held by the pools low without long pauses.  The lock is only
+ * held to choose the pool of each step, not while it is trimmed, so
+ * memory requests to the system in other threads are not held up.
+ * Pools with a non-negative group ID are not locked and are skipped.
+ *
+ * @param max_usec  time limit in microseconds
+ * @return          number of memory blocks freed
+ */
+size_t static_mem_pool_set::trim(long max_usec)
+{
+    std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() +
+            std::chrono::microseconds(max_usec);
+    size_t total = 0;
+    size_t idle = 0;    // Pools in a row found with nothing to trim
+    for (;;)
+    {
+        mem_pool_base* pool;
+        {
+            lock guard;
+            size_t count = _M_memory_pool_set.size();
+            if (idle >= count)
+                break;
+            if (_M_trim_next >= count)
+                _M_trim_next = 0;
+            pool = _M_memory_pool_set[_M_trim_next++];
+        }
+        size_t freed = pool->trim(STATIC_MEM_POOL_TRIM_STEP);
+        if (freed == 0)
+        {
+            ++idle;
+            continue;
+        }
+        idle = 0;
+        total += freed;
+        if (std::chrono::steady_clock::now() >= deadline)
+            break;
+    }
+    _STATIC_MEM_POOL_TRACE(false, total << " blocks are trimmed");
+    return total;
+}
+
+/**
+ * Gets the statistics of the static memory pools.  Pools that report
+ * nothing (those with a non-negative group ID, which are not locked)
+ * are left out.
+ *
+ * @return  the statistics, one entry per pool
+ */
+std::vector<mem_pool_stats> static_mem_pool_set::get_stats()
+{
+    lock guard;
+    std::vector<mem_pool_stats> result;
+    for (size_t i = 0; i < _M_memory_pool_set.size(); ++i)
+    {
+        mem_pool_stats stats = _M_memory_pool_set[i]->get_stats();
+        if (stats.block_size != 0)
+            result.push_back(stats);
+    }
+    return result;
+}
+
+/**
+ * Gets the bytes of the free memory blocks kept in all static memory
+ * pools (excluding the caches of threads).
+ *
+ * @return  the bytes cached
+ */
+size_t static_mem_pool_set::get_cached_bytes()
+{
+    std::vector<mem_pool_stats> stats = get_stats();
+    size_t bytes = 0;
+    for (size_t i = 0; i < stats.size(); ++i)
+        bytes += stats[i].free_blocks * stats[i].block_size;
+    return bytes;
+}
+
+/**
+ * Makes one trim step on the first pool, starting from where the last
+ * step stopped, that has free memory blocks above its high-water mark.
+ * The caller should hold the lock.
+ *
+ * @return  number of memory blocks freed; \c 0 if no pool has any
+ *          above its mark
+ */
+size_t static_mem_pool_set::_M_trim_step()
+{
+    size_t count = _M_memory_pool_set.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (_M_trim_next >= count)
+            _M_trim_next = 0;
+        mem_pool_base* pool = _M_memory_pool_set[_M_trim_next++];
+        if (size_t freed = pool->trim(STATIC_MEM_POOL_TRIM_STEP))
+            return freed;
+    }
+    return 0;
+}
+
 /**
  * Adds a new memory pool to nvwa#static_mem_pool_set.
  *
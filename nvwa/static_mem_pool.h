@@ -65,6 +65,45 @@
         ((void)0)
 # endif
 
+/* Defines whether locked pools keep per-thread caches of free blocks */
+# if !defined(_STATIC_MEM_POOL_THREAD_CACHE)
+#   if HAVE_CXX11_THREAD_LOCAL && !defined(_NOTHREADS)
+#     define _STATIC_MEM_POOL_THREAD_CACHE 1
+#   else
+#     define _STATIC_MEM_POOL_THREAD_CACHE 0
+#   endif
+# endif
+
+/**
+ * Defines the number of free blocks a thread cache moves from or to the
+ * shared free list at a time.  A thread keeps at most twice as many per
+ * pool, so with \e T threads and \e P locked pools up to
+ * 2 * \e T * \e P * STATIC_MEM_POOL_BATCH_SIZE free blocks sit in
+ * thread caches, out of reach of recycle and trim.  A thread whose
+ * request to the system fails empties its own caches first; the caches
+ * of other threads are only emptied when these threads exit or call
+ * static_mem_pool::release_thread_cache.
+ */
+#ifndef STATIC_MEM_POOL_BATCH_SIZE
+#define STATIC_MEM_POOL_BATCH_SIZE 64
+#endif
+
+/**
+ * Defines the number of free blocks a pool keeps when trimmed, unless
+ * set otherwise with static_mem_pool::set_high_water_mark.
+ */
+#ifndef STATIC_MEM_POOL_HIGH_WATER_MARK
+#define STATIC_MEM_POOL_HIGH_WATER_MARK 1024
+#endif
+
+/**
+ * Defines the number of free blocks a trim step frees at most from one
+ * pool.
+ */
+#ifndef STATIC_MEM_POOL_TRIM_STEP
+#define STATIC_MEM_POOL_TRIM_STEP 256
+#endif
+
 NVWA_NAMESPACE_BEGIN
 
 /**
@@ -77,14 +116,22 @@ public:
     typedef class_level_lock<static_mem_pool_set>::lock lock;
     static static_mem_pool_set& instance();
     void recycle();
+    void release_thread_caches();
+    size_t trim(long max_usec);
+    std::vector<mem_pool_stats> get_stats();
+    size_t get_cached_bytes();
     void add(mem_pool_base* memory_pool_p);
 
 private:
+    template <size_t _Sz, int _Gid> friend class static_mem_pool;
+
     static_mem_pool_set();
     ~static_mem_pool_set();
+    size_t _M_trim_step();
 
     typedef std::vector<mem_pool_base*> container_type;
     container_type _M_memory_pool_set;
+    size_t _M_trim_next;
 
     /* Forbid their use */
     static_mem_pool_set(const static_mem_pool_set&);
@@ -139,12 +186,62 @@ public:
     /**
      * Allocates memory and returns its pointer.  The template will try
      * to get it from the memory pool first, and request memory from the
-     * system if there is no free memory in the pool.
+     * system if there is no free memory in the pool.  If the pool is
+     * locked and thread caches are enabled, the block comes from the
+     * cache of the calling thread, which is refilled from the pool a
+     * batch at a time.
      *
      * @return  pointer to allocated memory if successful; \c NULL
      *          otherwise
      */
     void* allocate()
+    {
+#   if _STATIC_MEM_POOL_THREAD_CACHE
+        if (_Gid < 0)
+        {
+            _Thread_cache& cache = _S_thread_cache();
+            if (!cache._M_first && !_S_refill(cache))
+                return NULL;
+            _Block_list* result = cache._M_first;
+            cache._M_first = result->_M_next;
+            --cache._M_count;
+            return result;
+        }
+#   endif
+        return allocate_uncached();
+    }
+    /**
+     * Deallocates memory by putting the memory block into the pool (or
+     * into the cache of the calling thread, which gives a batch back to
+     * the pool when it is full).
+     *
+     * @param ptr  pointer to memory to be deallocated
+     */
+    void deallocate(void* ptr)
+    {
+        assert(ptr != NULL);
+#   if _STATIC_MEM_POOL_THREAD_CACHE
+        if (_Gid < 0)
+        {
+            _Thread_cache& cache = _S_thread_cache();
+            _Block_list* block = reinterpret_cast<_Block_list*>(ptr);
+            block->_M_next = cache._M_first;
+            cache._M_first = block;
+            if (++cache._M_count >= 2 * STATIC_MEM_POOL_BATCH_SIZE)
+                _S_drain(cache, STATIC_MEM_POOL_BATCH_SIZE);
+            return;
+        }
+#   endif
+        deallocate_uncached(ptr);
+    }
+    /**
+     * Allocates memory directly from the shared free list, bypassing
+     * the thread cache.
+     *
+     * @return  pointer to allocated memory if successful; \c NULL
+     *          otherwise
+     */
+    void* allocate_uncached()
     {
         {
             lock guard;
@@ -152,25 +249,54 @@ public:
             {
                 void* result = _S_memory_block_p;
                 _S_memory_block_p = _S_memory_block_p->_M_next;
+                --_S_free_cnt;
                 return result;
             }
         }
         return _S_alloc_sys(_S_align(_Sz));
     }
     /**
-     * Deallocates memory by putting the memory block into the pool.
+     * Deallocates memory directly into the shared free list, bypassing
+     * the thread cache.
      *
      * @param ptr  pointer to memory to be deallocated
      */
-    void deallocate(void* ptr)
+    void deallocate_uncached(void* ptr)
     {
         assert(ptr != NULL);
         lock guard;
         _Block_list* block = reinterpret_cast<_Block_list*>(ptr);
         block->_M_next = _S_memory_block_p;
         _S_memory_block_p = block;
+        ++_S_free_cnt;
+    }
+    /**
+     * Returns the free blocks cached by the calling thread to the pool,
+     * where recycle can reach them.  Other threads keep their caches.
+     */
+    virtual void release_thread_cache()
+    {
+#   if _STATIC_MEM_POOL_THREAD_CACHE
+        if (_Gid < 0)
+        {
+            _Thread_cache& cache = _S_thread_cache();
+            _S_drain(cache, cache._M_count);
+        }
+#   endif
+    }
+    /**
+     * Sets the number of free blocks the pool keeps when trimmed.
+     *
+     * @param blocks  number of free blocks to keep
+     */
+    void set_high_water_mark(size_t blocks)
+    {
+        lock guard;
+        _S_high_water_mark = blocks;
     }
     virtual void recycle();
+    virtual size_t trim(size_t max_blocks);
+    virtual mem_pool_stats get_stats() const;
 
 private:
     static_mem_pool()
@@ -191,6 +317,7 @@ private:
             block = next;
         }
         _S_memory_block_p = NULL;
+        _S_free_cnt = 0;
 #   endif
         _S_instance_p = NULL;
         _S_destroyed = true;
@@ -207,6 +334,38 @@ private:
     static bool _S_destroyed;
     static static_mem_pool* _S_instance_p;
     static mem_pool_base::_Block_list* _S_memory_block_p;
+    static size_t _S_free_cnt;
+    static size_t _S_high_water_mark;
+    static size_t _S_trim_cnt;
+    static size_t _S_trimmed_cnt;
+
+#   if _STATIC_MEM_POOL_THREAD_CACHE
+    /** Free blocks owned by one thread, handed out without locking. */
+    struct _Thread_cache
+    {
+        _Block_list* _M_first;
+        size_t       _M_count;
+        ~_Thread_cache()
+        {
+            // Gives the blocks back when the thread exits
+            if (_M_count != 0 && _S_instance_p)
+                _S_drain(*this, _M_count);
+        }
+    };
+    static bool _S_refill(_Thread_cache& cache);
+    static void _S_drain(_Thread_cache& cache, size_t count);
+
+    /**
+     * Gets the cache of the calling thread.  It is a local variable, as
+     * GCC may emit clashing guards for the thread_local static members
+     * of several instantiations.
+     */
+    static _Thread_cache& _S_thread_cache()
+    {
+        static thread_local _Thread_cache cache = { NULL, 0 };
+        return cache;
+    }
+#   endif
 
     /* Forbid their use */
     static_mem_pool(const static_mem_pool&);
@@ -217,13 +376,25 @@ template <size_t _Sz, int _Gid> bool
         static_mem_pool<_Sz, _Gid>::_S_destroyed = false;
 template <size_t _Sz, int _Gid> mem_pool_base::_Block_list*
         static_mem_pool<_Sz, _Gid>::_S_memory_block_p = NULL;
+template <size_t _Sz, int _Gid> size_t
+        static_mem_pool<_Sz, _Gid>::_S_free_cnt = 0;
+template <size_t _Sz, int _Gid> size_t
+        static_mem_pool<_Sz, _Gid>::_S_high_water_mark =
+                STATIC_MEM_POOL_HIGH_WATER_MARK;
+template <size_t _Sz, int _Gid> size_t
+        static_mem_pool<_Sz, _Gid>::_S_trim_cnt = 0;
+template <size_t _Sz, int _Gid> size_t
+        static_mem_pool<_Sz, _Gid>::_S_trimmed_cnt = 0;
 template <size_t _Sz, int _Gid> static_mem_pool<_Sz, _Gid>*
         static_mem_pool<_Sz, _Gid>::_S_instance_p = _S_create_instance();
 
 /**
  * Recycles half of the free memory blocks in the memory pool to the
  * system.  It is called when a memory request to the system (in other
- * instances of the static memory pool) fails.
+ * instances of the static memory pool) fails.  Blocks in the caches of
+ * threads are not seen: up to 2 * #STATIC_MEM_POOL_BATCH_SIZE blocks
+ * per thread.  The thread whose request fails returns its own ones
+ * (static_mem_pool_set::release_thread_caches) before recycling.
  */
 template <size_t _Sz, int _Gid>
 void static_mem_pool<_Sz, _Gid>::recycle()
@@ -240,6 +411,7 @@ void static_mem_pool<_Sz, _Gid>::recycle()
             _Block_list* next = temp->_M_next;
             block->_M_next = next;
             dealloc_sys(temp);
+            --_S_free_cnt;
             block = next;
         }
         else
@@ -251,19 +423,177 @@ void static_mem_pool<_Sz, _Gid>::recycle()
                                   << _Gid << "> is recycled");
 }
 
+/**
+ * Frees up to \a max_blocks free memory blocks above the high-water
+ * mark.  The pool lock is held only to unlink them; they are returned
+ * to the system after it is released.  A pool with a non-negative group
+ * ID has no real lock, so it may be used by its owning thread only and
+ * is not trimmed here, as trimming may happen in any thread.
+ *
+ * @param max_blocks  maximum number of memory blocks to free
+ * @return            number of memory blocks freed
+ */
+template <size_t _Sz, int _Gid>
+size_t static_mem_pool<_Sz, _Gid>::trim(size_t max_blocks)
+{
+    if (_Gid >= 0)
+        return mem_pool_base::trim(max_blocks);
+    _Block_list* first;
+    size_t count;
+    {
+        lock guard;
+        if (_S_free_cnt <= _S_high_water_mark || max_blocks == 0)
+            return 0;
+        count = _S_free_cnt - _S_high_water_mark;
+        if (count > max_blocks)
+            count = max_blocks;
+        first = _S_memory_block_p;
+        _Block_list* last = first;
+        for (size_t i = 1; i < count; ++i)
+            last = last->_M_next;
+        _S_memory_block_p = last->_M_next;
+        last->_M_next = NULL;
+        _S_free_cnt -= count;
+        ++_S_trim_cnt;
+        _S_trimmed_cnt += count;
+    }
+    while (first)
+    {
+        _Block_list* next = first->_M_next;
+        dealloc_sys(first);
+        first = next;
+    }
+    return count;
+}
+
+/**
+ * Gets the statistics of the memory pool.  Free blocks in the caches of
+ * threads are not counted.  A pool with a non-negative group ID reports
+ * nothing, as its counters can only be read safely by its owning
+ * thread.
+ *
+ * @return  the statistics of the memory pool
+ */
+template <size_t _Sz, int _Gid>
+mem_pool_stats static_mem_pool<_Sz, _Gid>::get_stats() const
+{
+    if (_Gid >= 0)
+        return mem_pool_base::get_stats();
+    lock guard;
+    mem_pool_stats stats = { _S_align(_Sz), _S_free_cnt, _S_high_water_mark,
+                             _S_trim_cnt, _S_trimmed_cnt };
+    return stats;
+}
+
+/**
+ * Allocates memory from the system.  If that fails, the pools are
+ * trimmed step by step, retrying after each step, and only when no pool
+ * has free blocks above its high-water mark are all of them recycled.
+ */
 template <size_t _Sz, int _Gid>
 void* static_mem_pool<_Sz, _Gid>::_S_alloc_sys(size_t size)
 {
+    static_mem_pool_set& pool_set = static_mem_pool_set::instance();
     static_mem_pool_set::lock guard;
     void* result = mem_pool_base::alloc_sys(size);
     if (!result)
     {
-        static_mem_pool_set::instance().recycle();
+        // Gives this thread's cached blocks of all pools a chance
+        pool_set.release_thread_caches();
+        result = mem_pool_base::alloc_sys(size);
+    }
+    while (!result && pool_set._M_trim_step() != 0)
+        result = mem_pool_base::alloc_sys(size);
+    if (!result)
+    {
+        pool_set.recycle();
         result = mem_pool_base::alloc_sys(size);
     }
     return result;
 }
 
+#if _STATIC_MEM_POOL_THREAD_CACHE
+/**
+ * Moves a batch of free blocks into an empty thread cache: from the
+ * shared free list if it has any, otherwise from the system.  Either
+ * source is locked only once per batch.
+ *
+ * @param cache  the cache of the calling thread
+ * @return       \c true if the cache has got at least one block
+ */
+template <size_t _Sz, int _Gid>
+bool static_mem_pool<_Sz, _Gid>::_S_refill(_Thread_cache& cache)
+{
+    assert(cache._M_first == NULL && cache._M_count == 0);
+    {
+        lock guard;
+        _Block_list* last = _S_memory_block_p;
+        if (last)
+        {
+            size_t count = 1;
+            while (count < STATIC_MEM_POOL_BATCH_SIZE && last->_M_next)
+            {
+                last = last->_M_next;
+                ++count;
+            }
+            cache._M_first = _S_memory_block_p;
+            cache._M_count = count;
+            _S_free_cnt -= count;
+            _S_memory_block_p = last->_M_next;
+            last->_M_next = NULL;
+            return true;
+        }
+    }
+    // The first block may need a recycle; the rest of the batch is
+    // merely a bonus
+    _Block_list* block =
+            reinterpret_cast<_Block_list*>(_S_alloc_sys(_S_align(_Sz)));
+    if (!block)
+        return false;
+    block->_M_next = NULL;
+    cache._M_first = block;
+    cache._M_count = 1;
+    static_mem_pool_set::lock guard;
+    while (cache._M_count < STATIC_MEM_POOL_BATCH_SIZE)
+    {
+        block = reinterpret_cast<_Block_list*>(
+                mem_pool_base::alloc_sys(_S_align(_Sz)));
+        if (!block)
+            break;
+        block->_M_next = cache._M_first;
+        cache._M_first = block;
+        ++cache._M_count;
+    }
+    return true;
+}
+
+/**
+ * Moves the first \a count blocks of a thread cache to the shared free
+ * list under one lock.
+ *
+ * @param cache  the cache of the calling thread
+ * @param count  number of blocks to move, not more than in the cache
+ */
+template <size_t _Sz, int _Gid>
+void static_mem_pool<_Sz, _Gid>::_S_drain(_Thread_cache& cache,
+                                          size_t count)
+{
+    assert(count <= cache._M_count);
+    if (count == 0)
+        return;
+    _Block_list* first = cache._M_first;
+    _Block_list* last = first;
+    for (size_t i = 1; i < count; ++i)
+        last = last->_M_next;
+    cache._M_first = last->_M_next;
+    cache._M_count -= count;
+    lock guard;
+    last->_M_next = _S_memory_block_p;
+    _S_memory_block_p = first;
+    _S_free_cnt += count;
+}
+#endif
+
 template <size_t _Sz, int _Gid>
 static_mem_pool<_Sz, _Gid>* static_mem_pool<_Sz, _Gid>::_S_create_instance()
 {
@@ -0,0 +1,523 @@
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <fc_queue.h>
+#include <fixed_mem_pool.h>
+#include <mem_pool_allocator.h>
+#include <static_mem_pool.h>
+#include <measure.h>
+// the pool classes below declare their own operator new, so debug_new
+// only checks for leaks at exit, after the static pools are gone
+#define _DEBUG_NEW_REDEFINE_NEW 0
+#include <debug_new.h>
+
+struct LockedBlock {
+    long stamp[3];
+    DECLARE_FIXED_MEM_POOL(LockedBlock)
+};
+
+struct LockFreeBlock {
+    long stamp[3];
+    DECLARE_FIXED_MEM_POOL(LockFreeBlock)
+};
+
+struct GrowableBlock {
+    long stamp[3];
+    DECLARE_FIXED_MEM_POOL(GrowableBlock)
+};
+
+struct LockFreeGrowableBlock {
+    long stamp[3];
+    DECLARE_FIXED_MEM_POOL(LockFreeGrowableBlock)
+};
+
+struct AlignedLockFreeBlock {
+    long stamp[3];
+    DECLARE_FIXED_MEM_POOL(AlignedLockFreeBlock)
+};
+
+NVWA_NAMESPACE_BEGIN
+template <>
+struct fixed_mem_pool<LockFreeBlock>::lock_free
+{
+    static const bool value = true;
+};
+
+template <>
+struct fixed_mem_pool<GrowableBlock>::growable
+{
+    static const bool value = true;
+};
+
+template <>
+struct fixed_mem_pool<LockFreeGrowableBlock>::lock_free
+{
+    static const bool value = true;
+};
+
+template <>
+struct fixed_mem_pool<LockFreeGrowableBlock>::growable
+{
+    static const bool value = true;
+};
+
+template <>
+struct fixed_mem_pool<AlignedLockFreeBlock>::alignment
+{
+    static const size_t value = 64;
+};
+
+template <>
+struct fixed_mem_pool<AlignedLockFreeBlock>::lock_free
+{
+    static const bool value = true;
+};
+NVWA_NAMESPACE_END
+
+const int max_threads = 8;
+const int held_per_thread = 1000;
+
+// Every thread takes n blocks at a time, stamps them and checks the
+// stamps before giving them back, so a block handed out twice is caught.
+// The pool holds exactly the blocks all threads take at once.
+template<class Block>
+void hammer_pool(int threads, int rounds, int n, bool check)
+{
+    typedef nvwa::fixed_mem_pool<Block> Pool;
+    std::vector<char> ok(threads, true);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&ok, t, rounds, n, check] () {
+            std::vector<Block*> held(n);
+            for (int r = 0; r < rounds; ++r) {
+                for (int i = 0; i < n; ++i) {
+                    held[i] = static_cast<Block*>(Pool::allocate());
+                    if (held[i] == NULL) {
+                        ok[t] = false;
+                        return;
+                    }
+                    held[i]->stamp[0] = t;
+                    held[i]->stamp[2] = i;
+                }
+                for (int i = n - 1; i >= 0; --i) {
+                    if (check && (held[i]->stamp[0] != t || held[i]->stamp[2] != i)) {
+                        ok[t] = false;
+                    }
+                    Pool::deallocate(held[i]);
+                }
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (int t = 0; t < threads; ++t) {
+        assert(ok[t]);
+    }
+    assert(Pool::get_alloc_count() == 0);
+}
+
+template<class Block>
+void test_fixed_pool()
+{
+    typedef nvwa::fixed_mem_pool<Block> Pool;
+    assert(Pool::initialize(max_threads * held_per_thread));
+    Block* b = new Block;
+    assert(Pool::get_alloc_count() == 1);
+    delete b;
+    hammer_pool<Block>(1, 100, held_per_thread, true);
+    hammer_pool<Block>(max_threads, 100, held_per_thread, true);
+    // every block out at once, then one more than the pool has
+    std::vector<void*> all;
+    for (int i = 0; i < max_threads * held_per_thread; ++i) {
+        all.push_back(Pool::allocate());
+        assert(all.back() != NULL);
+    }
+    assert(Pool::allocate() == NULL);
+    assert(Pool::deinitialize() == max_threads * held_per_thread);
+    for (void* p : all) {
+        Pool::deallocate(p);
+    }
+    assert(Pool::deinitialize() == 0);
+    assert(!Pool::is_initialized());
+}
+
+// A pool of 16 blocks grows to take a million, the later chunks in huge
+// pages, and gives all chunks back at once.
+template<class Block>
+void test_growable_pool()
+{
+    typedef nvwa::fixed_mem_pool<Block> Pool;
+    const int n = 1000000;
+    assert(Pool::initialize(16));
+    assert(Pool::get_block_count() == 16);
+    std::vector<Block*> all;
+    for (int i = 0; i < n; ++i) {
+        all.push_back(new Block);
+        all.back()->stamp[0] = i;
+    }
+    assert(Pool::get_alloc_count() == n);
+    assert(Pool::get_block_count() >= size_t(n));
+    assert(Pool::get_block_count() < size_t(4 * n));
+    for (int i = 0; i < n; ++i) {
+        assert(all[i]->stamp[0] == i);
+    }
+    assert(Pool::deinitialize() == n);
+    for (int i = 0; i < n; i += 2) {
+        delete all[i];
+    }
+    assert(Pool::get_alloc_count() == n / 2);
+    for (int i = 1; i < n; i += 2) {
+        delete all[i];
+    }
+    assert(Pool::deinitialize() == 0);
+    assert(!Pool::is_initialized());
+    // threads finding the pool empty at the same time grow it once
+    assert(Pool::initialize(1));
+    hammer_pool<Block>(max_threads, 10, held_per_thread, true);
+    assert(Pool::get_block_count() < size_t(2 * max_threads * held_per_thread));
+    assert(Pool::deinitialize() == 0);
+}
+
+// Blocks aligned beyond what the system gives stay aligned, also when
+// they go through the lock-free list.
+void test_aligned_pool()
+{
+    typedef nvwa::fixed_mem_pool<AlignedLockFreeBlock> Pool;
+    assert(Pool::initialize(100));
+    std::vector<void*> all;
+    for (int i = 0; i < 100; ++i) {
+        all.push_back(Pool::allocate());
+        assert(all.back() != NULL);
+        assert((reinterpret_cast<uintptr_t>(all.back()) & 63) == 0);
+    }
+    assert(Pool::allocate() == NULL);
+    for (void* p : all) {
+        Pool::deallocate(p);
+    }
+    assert(Pool::deinitialize() == 0);
+    test_fixed_pool<AlignedLockFreeBlock>();
+}
+
+struct Bytes20 {
+    char bytes[20];
+};
+
+struct Bytes300 {
+    char bytes[300];
+};
+
+void test_pool_allocator()
+{
+    static_assert(nvwa::pool_size_class<1>::value == 8, "");
+    static_assert(nvwa::pool_size_class<20>::value == 24, "");
+    static_assert(nvwa::pool_size_class<100>::value == 112, "");
+    static_assert(nvwa::pool_size_class<200>::value == 224, "");
+    static_assert(!nvwa::pool_size_class<300>::pooled, "");
+
+    // types of one size class share a pool, so a freed block is reused
+    nvwa::pool_allocator<Bytes20> alloc20;
+    nvwa::pool_allocator<double[3]> alloc24(alloc20);
+    Bytes20* p = alloc20.allocate(1);
+    alloc20.deallocate(p, 1);
+    double (*q)[3] = alloc24.allocate(1);
+    assert((void*)q == (void*)p);
+    alloc24.deallocate(q, 1);
+    assert(alloc20 == alloc24);
+
+    nvwa::pool_allocator<Bytes300> alloc300;
+    Bytes300* big = alloc300.allocate(1);
+    alloc300.deallocate(big, 1);
+    // no pool is made for objects too large for the pools
+    std::vector<nvwa::mem_pool_stats> stats =
+            nvwa::static_mem_pool_set::instance().get_stats();
+    for (size_t i = 0; i < stats.size(); ++i) {
+        assert(stats[i].block_size <= POOL_ALLOCATOR_MAX_SIZE);
+    }
+    int* array = nvwa::pool_allocator<int>().allocate(100);
+    nvwa::pool_allocator<int>().deallocate(array, 100);
+
+    nvwa::fc_queue<int, nvwa::pool_allocator<int> > queue(100);
+    for (int i = 0; i < 100; ++i) {
+        queue.push(i);
+    }
+    assert(queue.full());
+    nvwa::fc_queue<int, nvwa::pool_allocator<int> > copy(queue);
+    for (int i = 0; i < 100; ++i) {
+        assert(copy.front() == i);
+        copy.pop();
+    }
+    assert(copy.empty() && queue.size() == 100);
+}
+
+typedef nvwa::static_mem_pool<72, -2> TrimmedPool;
+
+nvwa::mem_pool_stats trimmed_pool_stats()
+{
+    std::vector<nvwa::mem_pool_stats> stats = nvwa::static_mem_pool_set::instance().get_stats();
+    for (size_t i = 0; i < stats.size(); ++i) {
+        if (stats[i].block_size == 72) {
+            return stats[i];
+        }
+    }
+    assert(false);
+    return stats[0];
+}
+
+void fill_trimmed_pool(int n)
+{
+    std::vector<void*> blocks;
+    for (int i = 0; i < n; ++i) {
+        blocks.push_back(TrimmedPool::instance_known().allocate());
+    }
+    for (void* p : blocks) {
+        TrimmedPool::instance_known().deallocate(p);
+    }
+    TrimmedPool::instance_known().release_thread_cache();
+}
+
+typedef nvwa::static_mem_pool<88, 0> UnlockedPool;
+
+// a pool without a lock is neither trimmed nor read from other threads
+void test_trim_unlocked()
+{
+    nvwa::static_mem_pool_set& pool_set = nvwa::static_mem_pool_set::instance();
+    UnlockedPool& pool = UnlockedPool::instance_known();
+    pool.set_high_water_mark(0);
+    void* p = pool.allocate();
+    pool.deallocate(p);
+    std::thread trimmer([&pool_set] () { pool_set.trim(1000000); });
+    trimmer.join();
+    assert(pool.allocate() == p);
+    pool.deallocate(p);
+    assert(pool.trim(100) == 0);
+    std::vector<nvwa::mem_pool_stats> stats = pool_set.get_stats();
+    for (size_t i = 0; i < stats.size(); ++i) {
+        assert(stats[i].block_size != 88);
+    }
+}
+
+// blocks freed into this thread's caches go back to the shared lists
+void test_release_thread_caches()
+{
+    void* p = TrimmedPool::instance_known().allocate();
+    TrimmedPool::instance_known().deallocate(p);
+    size_t shared = trimmed_pool_stats().free_blocks;
+    nvwa::static_mem_pool_set& pool_set = nvwa::static_mem_pool_set::instance();
+    {
+        nvwa::static_mem_pool_set::lock guard;
+        pool_set.release_thread_caches();
+    }
+    assert(trimmed_pool_stats().free_blocks > shared);
+}
+
+// every step frees a bounded number of blocks, down to the high-water mark
+void test_trim()
+{
+    nvwa::static_mem_pool_set& pool_set = nvwa::static_mem_pool_set::instance();
+    pool_set.trim(1000000);
+    TrimmedPool::instance_known().set_high_water_mark(1000);
+    fill_trimmed_pool(10000);
+    nvwa::mem_pool_stats before = trimmed_pool_stats();
+    assert(before.free_blocks >= 10000);
+    assert(before.high_water_mark == 1000);
+    size_t cached = pool_set.get_cached_bytes();
+    size_t freed = pool_set.trim(0);
+    assert(freed > 0 && freed <= STATIC_MEM_POOL_TRIM_STEP);
+    assert(trimmed_pool_stats().free_blocks == before.free_blocks - freed);
+    assert(pool_set.get_cached_bytes() == cached - freed * 72);
+    while (pool_set.trim(100) != 0) {
+    }
+    nvwa::mem_pool_stats after = trimmed_pool_stats();
+    assert(after.free_blocks == 1000);
+    assert(after.trimmed_blocks - before.trimmed_blocks == before.free_blocks - 1000);
+    assert(after.trims - before.trims >= (before.free_blocks - 1000) / STATIC_MEM_POOL_TRIM_STEP);
+}
+
+// the longest pause of trimming a million free blocks in steps of 1 ms,
+// against recycling half of them at once
+void measure_trim()
+{
+    const int n = 1000000;
+    nvwa::static_mem_pool_set& pool_set = nvwa::static_mem_pool_set::instance();
+    TrimmedPool::instance_known().set_high_water_mark(0);
+    fill_trimmed_pool(n);
+    long long longest = 0, total = 0;
+    size_t freed = 0;
+    do {
+        long long time = Nstd::measure<>::execution([&] () { freed = pool_set.trim(1000); });
+        longest = std::max(longest, time);
+        total += time;
+    } while (freed != 0);
+    fill_trimmed_pool(n);
+    long long recycle = Nstd::measure<>::execution([&] () {
+        nvwa::static_mem_pool_set::lock guard;
+        pool_set.recycle();
+    });
+    std::cout << "Trimming " << n << " free pool blocks in 1 ms steps takes " << total << " us, the longest step "
+              << longest << " us; recycling half of them takes " << recycle << " us at once" << std::endl;
+    pool_set.trim(1000000);
+}
+
+typedef nvwa::static_mem_pool<40, -3> FreshPool;
+
+// A thread taking fresh blocks from the system, which needs the lock of
+// the pool set, is not held up for the whole of a long trim.
+void measure_trim_latency()
+{
+    const int n = 1000000, max_fresh = 500000;
+    nvwa::static_mem_pool_set& pool_set = nvwa::static_mem_pool_set::instance();
+    TrimmedPool::instance_known().set_high_water_mark(0);
+    fill_trimmed_pool(n);
+    FreshPool& fresh_pool = FreshPool::instance_known();
+    std::atomic<bool> started(false), done(false);
+    std::vector<void*> fresh;
+    long long worst = 0;
+    std::thread allocator([&] () {
+        fresh.reserve(max_fresh);
+        started = true;
+        while (!done && fresh.size() < size_t(max_fresh)) {
+            void* p = NULL;
+            long long time = Nstd::measure<>::execution([&] () { p = fresh_pool.allocate_uncached(); });
+            worst = std::max(worst, time);
+            assert(p != NULL);
+            fresh.push_back(p);
+        }
+    });
+    while (!started) {
+        std::this_thread::yield();
+    }
+    size_t freed = 0;
+    long long trim = Nstd::measure<>::execution([&] () { freed = pool_set.trim(1000000); });
+    done = true;
+    allocator.join();
+    assert(freed >= size_t(n));
+    std::cout << "Trimming " << freed << " free pool blocks at once takes " << trim << " us, while the longest of "
+              << fresh.size() << " allocations from the system in another thread takes " << worst << " us" << std::endl;
+    assert(worst < trim / 2);
+    for (void* p : fresh) {
+        fresh_pool.deallocate_uncached(p);
+    }
+    fresh_pool.set_high_water_mark(0);
+    pool_set.trim(1000000);
+}
+
+void measure_fixed_pool()
+{
+    nvwa::fixed_mem_pool<LockedBlock>::initialize(max_threads * held_per_thread);
+    nvwa::fixed_mem_pool<LockFreeBlock>::initialize(max_threads * held_per_thread);
+    const int rounds = 2000, n = 100;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::cout << threads << " threads allocating and freeing " << rounds * n << " fixed pool blocks each: "
+                  << Nstd::measure<>::execution(hammer_pool<LockedBlock>, threads, rounds, n, false) << " us locked, "
+                  << Nstd::measure<>::execution(hammer_pool<LockFreeBlock>, threads, rounds, n, false) << " us lock-free" << std::endl;
+    }
+    assert(nvwa::fixed_mem_pool<LockedBlock>::deinitialize() == 0);
+    assert(nvwa::fixed_mem_pool<LockFreeBlock>::deinitialize() == 0);
+}
+
+typedef nvwa::static_mem_pool<24> Pool24;
+
+// Every thread stamps the blocks it holds and checks the stamps before
+// freeing them, so a block handed out twice is caught. Half of the blocks
+// are freed by the main thread at the end, from another thread's cache.
+void test_pool_threads(int threads)
+{
+    const int rounds = 200, n = 1000;
+    std::vector<std::vector<long*>> handed(threads);
+    std::vector<char> ok(threads, true);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&, t] () {
+            std::vector<long*> held;
+            for (int r = 0; r < rounds; ++r) {
+                for (int i = 0; i < n; ++i) {
+                    long* p = static_cast<long*>(Pool24::instance_known().allocate());
+                    *p = (long)r * threads * n + t * n + i;
+                    held.push_back(p);
+                }
+                for (int i = 0; i < n; ++i) {
+                    if (*held[i] != (long)r * threads * n + t * n + i) {
+                        ok[t] = false;
+                    }
+                    if (i % 2 == 0) {
+                        Pool24::instance_known().deallocate(held[i]);
+                    } else {
+                        handed[t].push_back(held[i]);
+                    }
+                }
+                held.clear();
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (int t = 0; t < threads; ++t) {
+        assert(ok[t]);
+        assert(int(handed[t].size()) == rounds * n / 2);
+        for (long* p : handed[t]) {
+            Pool24::instance_known().deallocate(p);
+        }
+    }
+    Pool24::instance_known().release_thread_cache();
+}
+
+// threads allocating and freeing n blocks at a time, with or without
+// the per-thread caches
+template<bool Cached>
+void pool_churn(int threads, int rounds, int n)
+{
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([rounds, n] () {
+            Pool24& pool = Pool24::instance_known();
+            std::vector<void*> held(n);
+            for (int r = 0; r < rounds; ++r) {
+                for (int i = 0; i < n; ++i) {
+                    held[i] = Cached ? pool.allocate() : pool.allocate_uncached();
+                }
+                for (int i = 0; i < n; ++i) {
+                    Cached ? pool.deallocate(held[i]) : pool.deallocate_uncached(held[i]);
+                }
+            }
+            pool.release_thread_cache();
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void measure_pool_threads()
+{
+    const int rounds = 2000, n = 100;
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        std::cout << threads << " threads allocating and freeing " << rounds * n << " pool blocks each: "
+                  << Nstd::measure<>::execution(pool_churn<false>, threads, rounds, n) << " us locked, "
+                  << Nstd::measure<>::execution(pool_churn<true>, threads, rounds, n) << " us with thread caches" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    test_fixed_pool<LockedBlock>();
+    test_fixed_pool<LockFreeBlock>();
+    test_growable_pool<GrowableBlock>();
+    test_growable_pool<LockFreeGrowableBlock>();
+    test_aligned_pool();
+    test_pool_threads(1);
+    test_pool_threads(8);
+    test_pool_allocator();
+    test_trim();
+    test_release_thread_caches();
+    test_trim_unlocked();
+    measure_pool_threads();
+    measure_fixed_pool();
+    measure_trim();
+    measure_trim_latency();
+    return 0;
+}
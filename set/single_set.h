@@ -1,19 +1,28 @@
 #pragma once
+#include <algorithm>
+#include <vector>
+#include <arena_allocator.h>
 #include <redblack_tree.h>
+#include <single_list.h>
 #include <debug_new.h>
 
-template<class Value, class TreeImpl=TRedBlackTree<Value>>
+// List is the scratch list that collects the result of the set operations
+// before the tree is rebuilt from it; any list with push_back and forward
+// iteration will do, e.g. TUnrolledLinkedList.
+template<class Value, class TreeImpl=TRedBlackTree<Value>, class List=TSingleLinkedList<Value, TArenaAllocator<Value>>>
 class TSingleSet {
 public:
     TSingleSet()
     {
     }
 
+    // sorted and deduplicated first, so the tree is built in one pass
     TSingleSet(std::initializer_list<Value> init)
     {
-        for (auto it = init.begin(); it != init.end(); ++it) {
-            tree.insert(*it);
-        }
+        std::vector<Value> values(init);
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        tree.assign_sorted(values.begin(), values.end());
     }
 
     TSingleSet(const TSingleSet& other) :
@@ -41,48 +50,142 @@ public:
     bool add(const Value& v) { return tree.insert(v); }
     bool remove(const Value& v) { return tree.remove(v); }
     bool find(const Value& v) const { return tree.find(v); }
+    // for tests; TreeImpl must provide rbt_satisfied
+    bool rbt_satisfied() { return tree.rbt_satisfied(); }
+
+    // Calls f on the values in [lo, hi) in ascending order. Finding lo
+    // takes a walk down the tree, then each value costs one step.
+    template<class Func>
+    void visit_range(const Value& lo, const Value& hi, Func f) const
+    {
+        for (InOrderIterator it = tree.lower_bound(lo), end = tree.end_inorder(); it != end && *it < hi; ++it) {
+            f(*it);
+        }
+    }
 
     void add(const TSingleSet& other)
     {
-        other.tree.in_order_traverse( [this] (Value v) { this->add(v); } ); 
+        if (few_next_to(other.size(), size())) {
+            other.tree.in_order_traverse( [this] (const Value& v) { this->add(v); } );
+        } else {
+            assign_merged(*this, other, true, true, true);
+        }
     }
 
     void remove(const TSingleSet& other)
     {
-        other.tree.in_order_traverse( [this] (Value v) { this->remove(v); } ); 
+        if (few_next_to(other.size(), size())) {
+            other.tree.in_order_traverse( [this] (const Value& v) { this->remove(v); } );
+        } else {
+            assign_merged(*this, other, true, false, false);
+        }
     }
 
     void set_intersection(const TSingleSet& other)
     {
-        TSingleLinkedList<Value> to_remove;
-        tree.in_order_traverse( [other, &to_remove] (Value v) { if(!other.find(v)) { to_remove.push_back(v); } } );
-        for (auto v : to_remove) {
-            remove(v);
+        if (few_next_to(size(), other.size())) {
+            List to_remove;
+            tree.in_order_traverse( [&other, &to_remove] (const Value& v) { if(!other.find(v)) { to_remove.push_back(v); } } );
+            for (const Value& v : to_remove) {
+                remove(v);
+            }
+        } else {
+            assign_merged(*this, other, false, true, false);
         }
     }
 
-    TSingleSet operator+(const TSingleSet& other)
+    // Fork-join versions of the three above on up to threads threads: a
+    // copy of other is combined with this set by split and join, see
+    // TRedBlackTree::unite. TreeImpl must provide unite, subtract and
+    // intersect.
+    void add(const TSingleSet& other, int threads)
     {
-        TSingleSet<Value, TreeImpl> result(*this);
-        result.add(other);
+        TreeImpl copy(other.tree);
+        tree.unite(std::move(copy), threads);
+    }
+
+    void remove(const TSingleSet& other, int threads)
+    {
+        TreeImpl copy(other.tree);
+        tree.subtract(std::move(copy), threads);
+    }
+
+    void set_intersection(const TSingleSet& other, int threads)
+    {
+        TreeImpl copy(other.tree);
+        tree.intersect(std::move(copy), threads);
+    }
+
+    TSingleSet operator+(const TSingleSet& other) const
+    {
+        TSingleSet result;
+        result.assign_merged(*this, other, true, true, true);
         return result;
     }
 
-    TSingleSet operator-(const TSingleSet& other)
+    TSingleSet operator-(const TSingleSet& other) const
     {
-        TSingleSet<Value, TreeImpl> result(*this);
-        result.remove(other);
+        TSingleSet result;
+        result.assign_merged(*this, other, true, false, false);
         return result;
     }
 
-    TSingleSet operator&(const TSingleSet& other)
+    TSingleSet operator&(const TSingleSet& other) const
     {
-        TSingleSet<Value, TreeImpl> result(*this);
-        result.set_intersection(other);
+        TSingleSet result;
+        result.assign_merged(*this, other, false, true, false);
         return result;
     }
 
 private:
+    typedef typename TreeImpl::InOrderIterator InOrderIterator;
+
     TreeImpl tree;
 
+    // m tree operations of O(log n) each beat an O(m + n) rebuild
+    static bool few_next_to(int m, int n)
+    {
+        int log_n = 1;
+        while ((n >> log_n) != 0) {
+            ++log_n;
+        }
+        return static_cast<long long>(m) * log_n < n;
+    }
+
+    // Walks a and b in order side by side and rebuilds the tree from the
+    // values that are only in a, in both, or only in b, as the flags say.
+    // The values are collected first, so a or b may be this set.
+    void assign_merged(const TSingleSet& a, const TSingleSet& b, bool only_a, bool both, bool only_b)
+    {
+        List merged;
+        InOrderIterator ia = a.tree.begin_inorder(), a_end = a.tree.end_inorder();
+        InOrderIterator ib = b.tree.begin_inorder(), b_end = b.tree.end_inorder();
+        while (ia != a_end && ib != b_end) {
+            if (*ia < *ib) {
+                if (only_a) {
+                    merged.push_back(*ia);
+                }
+                ++ia;
+            } else if (*ib < *ia) {
+                if (only_b) {
+                    merged.push_back(*ib);
+                }
+                ++ib;
+            } else {
+                if (both) {
+                    merged.push_back(*ia);
+                }
+                ++ia;
+                ++ib;
+            }
+        }
+        for (; only_a && ia != a_end; ++ia) {
+            merged.push_back(*ia);
+        }
+        for (; only_b && ib != b_end; ++ib) {
+            merged.push_back(*ib);
+        }
+        tree.assign_sorted(merged.begin(), merged.end());
+    }
+
 };
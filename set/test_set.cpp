@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <thread>
 #include <single_set.h>
+#include <bplus_tree.h>
+#include <arena_allocator.h>
+#include <unrolled_list.h>
 #include <measure.h>
 #include <debug_new.h>
 
@@ -33,34 +38,72 @@ void test_set_ops()
     assert(set3.size() == 4);
 }
 
-void set_insert_rb(TSingleSet<int>& set, int N)
+template<class Set>
+void set_insert(Set& set, int N)
 {
     for (int i = 0; i < N; i++) {
         set.add(i);
     }
 }
 
-void set_insert_bt(TSingleSet<int, TBinaryTree<int>>& set, int N)
+template<class Set>
+void set_fill_and_destroy(int N)
+{
+    Set set;
+    set_insert(set, N);
+}
+
+template<class Set>
+void measure_ins_time(const char* name, int max_N)
+{
+    for (int N = 5; N < max_N; N *= 2) {
+        Set set;
+        std::cout << "Inserting " << N << " items to " << name << " takes " << Nstd::measure<>::execution(set_insert<Set>, set, N) << " us" << std::endl;
+    }
+}
+
+template<class Set>
+void measure_fill_and_destroy(const char* name, int N)
+{
+    std::cout << "Filling and destroying " << name << " of " << N << " items takes " << Nstd::measure<>::execution(set_fill_and_destroy<Set>, N) << " us" << std::endl;
+}
+
+template<class Set>
+void set_find(const Set& set, int N, int& found)
 {
     for (int i = 0; i < N; i++) {
-        set.add(i);
+        found += set.find(rand() % (2 * N)) ? 1 : 0;
     }
 }
 
+template<class Set>
+void measure_find_time(const char* name, int N)
+{
+    Set set;
+    set_insert(set, N);
+    int found = 0;
+    std::cout << "Looking up " << N << " random items in " << name << " of " << N << " items takes " << Nstd::measure<>::execution(set_find<Set>, set, N, found) << " us" << std::endl;
+    assert(found > 0);
+}
+
 void measure_ins_time()
 {
-    int N = 5;
-    while(N < 10000000) {
-        TSingleSet<int> set;
-        std::cout << "Inserting " << N << " items to RB-tree-based set takes " << Nstd::measure<>::execution(set_insert_rb, set, N) << " us" << std::endl;
-        N *= 2;
-    }
-    N = 5;
-    while(N < 50000) {
-        TSingleSet<int, TBinaryTree<int>> set;
-        std::cout << "Inserting " << N << " items to binary tree-based set takes " << Nstd::measure<>::execution(set_insert_bt, set, N) << " us" << std::endl;
-        N *= 2;
-    }
+    typedef TSingleSet<int, TRedBlackTree<int, std::allocator<int>>> HeapSet;
+    typedef TSingleSet<int, TRedBlackTree<int, TArenaAllocator<int>>> ArenaSet;
+    measure_ins_time<TSingleSet<int>>("RB-tree-based set", 10000000);
+    measure_ins_time<HeapSet>("RB-tree-based set with std::allocator", 10000000);
+    measure_ins_time<ArenaSet>("RB-tree-based set with TArenaAllocator", 10000000);
+    measure_ins_time<TSingleSet<int, TBinaryTree<int>>>("binary tree-based set", 50000);
+    measure_ins_time<TSingleSet<int, TBPlusTree<int>>>("B+-tree-based set", 10000000);
+
+    const int N = 1000000;
+    measure_fill_and_destroy<TSingleSet<int>>("RB-tree-based set", N);
+    measure_fill_and_destroy<HeapSet>("RB-tree-based set with std::allocator", N);
+    measure_fill_and_destroy<ArenaSet>("RB-tree-based set with TArenaAllocator", N);
+    measure_fill_and_destroy<TSingleSet<int, TBPlusTree<int>>>("B+-tree-based set", N);
+
+    measure_find_time<TSingleSet<int>>("RB-tree-based set", N);
+    measure_find_time<TSingleSet<int, TBPlusTree<int>>>("B+-tree-based set", N);
 }
 
 template <class Tree>
@@ -135,6 +178,224 @@ void test_arith_ops()
     assert((set1 - set4).size() == 3);
 }
 
+// sizes from tiny to equal, so that both the per-element and the merging
+// paths of the set operations run
+template<class Set>
+void test_merge_ops()
+{
+    const int sizes[] = { 0, 1, 10, 1000, 5000 };
+    for (int n1 : sizes) {
+        for (int n2 : sizes) {
+            Set set1, set2;
+            for (int i = 0; i < n1; i++) {
+                set1.add(rand() % 10000);
+            }
+            for (int i = 0; i < n2; i++) {
+                set2.add(rand() % 10000);
+            }
+            Set sum = set1 + set2, diff = set1 - set2, common = set1 & set2;
+            Set added(set1), removed(set1), intersected(set1);
+            added.add(set2);
+            removed.remove(set2);
+            intersected.set_intersection(set2);
+            int n_sum = 0, n_diff = 0, n_common = 0;
+            for (int v = 0; v < 10000; v++) {
+                bool in1 = set1.find(v), in2 = set2.find(v);
+                assert(sum.find(v) == (in1 || in2));
+                assert(diff.find(v) == (in1 && !in2));
+                assert(common.find(v) == (in1 && in2));
+                assert(added.find(v) == sum.find(v));
+                assert(removed.find(v) == diff.find(v));
+                assert(intersected.find(v) == common.find(v));
+                n_sum += (in1 || in2) ? 1 : 0;
+                n_diff += (in1 && !in2) ? 1 : 0;
+                n_common += (in1 && in2) ? 1 : 0;
+            }
+            assert(sum.size() == n_sum && added.size() == n_sum);
+            assert(diff.size() == n_diff && removed.size() == n_diff);
+            assert(common.size() == n_common && intersected.size() == n_common);
+        }
+    }
+    Set set({ 1, 2, 3 });
+    set.add(set);
+    assert(set.size() == 3);
+    set.set_intersection(set);
+    assert(set.size() == 3);
+    set.remove(set);
+    assert(set.size() == 0);
+}
+
+template<class Set>
+void fill_strided(Set& set, int N, int stride)
+{
+    for (int i = 0; i < N; i++) {
+        set.add(stride * i);
+    }
+}
+
+template<class Set>
+void measure_set_ops(const char* name, int N)
+{
+    Set set1, set2;
+    fill_strided(set1, N, 2);
+    fill_strided(set2, N, 3);
+    // the common values are the multiples of 6 below 2 * N
+    const int common = (N + 2) / 3;
+    int size = 0;
+    std::cout << "Union of two " << name << "s of " << N << " items takes " << Nstd::measure<>::execution(
+        [&] () { size = (set1 + set2).size(); }
+    ) << " us" << std::endl;
+    assert(size == N + N - common);
+    std::cout << "Difference of two " << name << "s of " << N << " items takes " << Nstd::measure<>::execution(
+        [&] () { size = (set1 - set2).size(); }
+    ) << " us" << std::endl;
+    assert(size == N - common);
+    std::cout << "Intersection of two " << name << "s of " << N << " items takes " << Nstd::measure<>::execution(
+        [&] () { size = (set1 & set2).size(); }
+    ) << " us" << std::endl;
+    assert(size == common);
+}
+
+// the fork-join operations give what the merging ones give
+void test_fork_join_ops(int threads)
+{
+    typedef TSingleSet<int> Set;
+    const int sizes[] = { 0, 1, 1000, 5000 };
+    for (int n1 : sizes) {
+        for (int n2 : sizes) {
+            Set set1, set2;
+            for (int i = 0; i < n1; i++) {
+                set1.add(rand() % 10000);
+            }
+            for (int i = 0; i < n2; i++) {
+                set2.add(rand() % 10000);
+            }
+            Set sum = set1 + set2, diff = set1 - set2, common = set1 & set2;
+            Set added(set1), removed(set1), intersected(set1);
+            added.add(set2, threads);
+            removed.remove(set2, threads);
+            intersected.set_intersection(set2, threads);
+            for (Set* set : { &added, &removed, &intersected }) {
+                assert(set->rbt_satisfied());
+                int v = rand() % 10000;
+                bool had = set->find(v);
+                assert(set->add(v) == !had);
+                assert(set->rbt_satisfied());
+                if (!had) {
+                    assert(set->remove(v));
+                }
+                assert(set->rbt_satisfied());
+            }
+            assert(added.size() == sum.size());
+            assert(removed.size() == diff.size());
+            assert(intersected.size() == common.size());
+            for (int v = 0; v < 10000; v++) {
+                assert(added.find(v) == sum.find(v));
+                assert(removed.find(v) == diff.find(v));
+                assert(intersected.find(v) == common.find(v));
+            }
+        }
+    }
+    Set set({ 1, 2, 3 });
+    set.add(set, threads);
+    set.set_intersection(set, threads);
+    assert(set.size() == 3);
+    set.remove(set, threads);
+    assert(set.size() == 0);
+    // the halves of a split by the root of the other set keep red roots
+    Set small({ 0, 1 }), zero({ 0 });
+    small.remove(zero, threads);
+    assert(small.rbt_satisfied());
+    assert(small.add(2));
+    assert(small.rbt_satisfied() && small.size() == 2);
+}
+
+// The fork-join operations on 1 to max(4, cores) threads next to the
+// merging ones; both include copying the other set.
+void measure_parallel_set_ops(int N)
+{
+    typedef TSingleSet<int> Set;
+    Set set1, set2;
+    for (int i = 0; i < N; i++) {
+        set1.add(rand());
+        set2.add(rand() % (4 * N));
+    }
+    std::cout << "Merging intersection of sets of " << set1.size() << " and " << set2.size() << " items takes " << Nstd::measure<>::execution(
+        [&] () { Set result(set1); result.set_intersection(set2); }
+    ) << " us" << std::endl;
+    int max_threads = std::max(4, (int)std::thread::hardware_concurrency());
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::cout << "Fork-join union on " << threads << " threads takes " << Nstd::measure<>::execution(
+            [&] () { Set result(set1); result.add(set2, threads); }
+        ) << " us" << std::endl;
+        std::cout << "Fork-join intersection on " << threads << " threads takes " << Nstd::measure<>::execution(
+            [&] () { Set result(set1); result.set_intersection(set2, threads); }
+        ) << " us" << std::endl;
+        std::cout << "Fork-join difference on " << threads << " threads takes " << Nstd::measure<>::execution(
+            [&] () { Set result(set1); result.remove(set2, threads); }
+        ) << " us" << std::endl;
+    }
+}
+
+template<class Set>
+void test_visit_range()
+{
+    Set set;
+    for (int i = 0; i < 1000; i++) {
+        set.add(3 * i);
+    }
+    int count = 0, last = -1;
+    set.visit_range(10, 100, [&] (int v) { assert(v >= 10 && v < 100 && v > last); last = v; ++count; } );
+    assert(count == 30);
+    count = 0;
+    set.visit_range(12, 13, [&count] (int) { ++count; } );
+    assert(count == 1);
+    set.visit_range(13, 15, [&count] (int) { ++count; } );
+    set.visit_range(100, 10, [&count] (int) { ++count; } );
+    set.visit_range(5000, 6000, [&count] (int) { ++count; } );
+    assert(count == 1);
+    set.visit_range(-10, 5000, [&count] (int) { ++count; } );
+    assert(count == 1001);
+}
+
+// windows of 100 values out of N, reached through lower_bound by
+// visit_range and by filtering a walk over the whole set
+template<class Set>
+void measure_range_scan(const char* name, int N)
+{
+    Set set;
+    set_insert(set, N);
+    const int ranges = 10;
+    std::vector<int> starts;
+    for (int i = 0; i < ranges; i++) {
+        starts.push_back(rand() % N);
+    }
+    long long sum_bounded = 0, sum_filtered = 0;
+    std::cout << "Scanning " << ranges << " ranges in " << name << " of " << N << " items takes " << Nstd::measure<>::execution(
+        [&] () { for (int lo : starts) { set.visit_range(lo, lo + 100, [&sum_bounded] (int v) { sum_bounded += v; } ); } }
+    ) << " us with visit_range, " << Nstd::measure<>::execution(
+        [&] () { for (int lo : starts) { set.visit_range(0, N, [&sum_filtered, lo] (int v) { if (v >= lo && v < lo + 100) sum_filtered += v; } ); } }
+    ) << " us with a full walk" << std::endl;
+    assert(sum_bounded == sum_filtered);
+}
+
+void test_unrolled_scratch_list()
+{
+    typedef TSingleSet<int, TRedBlackTree<int>, TUnrolledLinkedList<int>> UnrolledSet;
+    UnrolledSet set1;
+    UnrolledSet set2;
+    for (int i = 0; i < 1000; i++) {
+        set1.add(i);
+        set2.add(3 * i);
+    }
+    set1.set_intersection(set2);
+    assert(set1.size() == 334);
+    for (int i = 0; i < 1000; i++) {
+        assert(set1.find(i) == (i % 3 == 0));
+    }
+    assert((set2 & UnrolledSet({0, 1, 2, 3})).size() == 2);
+}
+
 int main(int argc, char* argv[])
 {
     test_basic();
@@ -143,6 +404,21 @@ int main(int argc, char* argv[])
     measure_ins_time();
     test_move_copy<TBinaryTree<int>>();
     test_move_copy<TRedBlackTree<int>>();
+    test_move_copy<TRedBlackTree<int, TArenaAllocator<int>>>();
+    test_move_copy<TRedBlackTree<int, std::allocator<int>>>();
+    test_move_copy<TBPlusTree<int>>();
     test_arith_ops();
+    test_unrolled_scratch_list();
+    test_merge_ops<TSingleSet<int>>();
+    test_merge_ops<TSingleSet<int, TBPlusTree<int>>>();
+    test_fork_join_ops(1);
+    test_fork_join_ops(4);
+    test_visit_range<TSingleSet<int>>();
+    test_visit_range<TSingleSet<int, TBPlusTree<int>>>();
+    measure_set_ops<TSingleSet<int>>("RB-tree-based set", 1000000);
+    measure_set_ops<TSingleSet<int, TBPlusTree<int>>>("B+-tree-based set", 1000000);
+    measure_parallel_set_ops(1000000);
+    measure_range_scan<TSingleSet<int>>("RB-tree-based set", 1000000);
+    measure_range_scan<TSingleSet<int, TBPlusTree<int>>>("B+-tree-based set", 1000000);
     return 0;
 }
\ No newline at end of file
@@ -1,65 +1,223 @@
 #pragma once
-#include <single_list.h>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <arena_allocator.h>
+#include <pool_allocator.h>
 #include <debug_new.h>
 
+// Links and value shared by the nodes of all trees; Node is the most
+// derived node type, so the links need no casts. The tree code reaches the
+// parent only through parent() and set_parent(), so a node type may pack
+// other state into the parent link (see TRedBlackTreeNode).
+template<class Value, class Node>
+class TBinaryTreeNodeBase {
+public:
+    TBinaryTreeNodeBase(const Value& _v) :
+        left( 0 ),
+        right( 0 ),
+        parent_link( 0 ),
+        v( _v )
+    {
+
+    }
+
+    Node* parent() const
+    {
+        return parent_link;
+    }
+
+    void set_parent(Node* p)
+    {
+        parent_link = p;
+    }
+
+    Node* left;
+    Node* right;
+
+private:
+    Node* parent_link;
+
+public:
+    Value v;
+};
+
 template<class Value>
-class TBinaryTree {
-protected:
-    class Node {
-    friend class TBinaryTree;
-    protected:
-        Node(const Value& _v) : 
-            left( 0 ),
-            right( 0 ),
-            parent( 0 ),
-            v( _v )
+class TBinaryTreeNode : public TBinaryTreeNodeBase<Value, TBinaryTreeNode<Value>> {
+public:
+    TBinaryTreeNode(const Value& _v) :
+        TBinaryTreeNodeBase<Value, TBinaryTreeNode<Value>>( _v )
+    {
+    }
+};
+
+// Orders in which the tree iterators walk the nodes: first() is the first
+// node of the subtree at root, next() the node following n, 0 at the end.
+struct tree_traversal {
+    struct pre_order {
+        template<class Node>
+        static Node* first(Node* root)
+        {
+            return root;
+        }
+
+        template<class Node>
+        static Node* next(Node* n)
+        {
+            assert(n != 0);
+            if (n->left != 0) {
+                return n->left;
+            }
+            if (n->right != 0) {
+                return n->right;
+            }
+            Node* prev = 0;
+            do {
+                prev = n;
+                n = n->parent();
+            } while (n != 0 && (prev == n->right || n->right == 0));
+            return n != 0 ? n->right : 0;
+        }
+    };
+
+    struct in_order {
+        template<class Node>
+        static Node* first(Node* root)
+        {
+            return root != 0 ? leftmost(root) : 0;
+        }
+
+        template<class Node>
+        static Node* next(Node* n)
+        {
+            assert(n != 0);
+            if (n->right != 0) {
+                return leftmost(n->right);
+            }
+            Node* prev = 0;
+            do {
+                prev = n;
+                n = n->parent();
+            } while (n != 0 && prev == n->right);
+            return n;
+        }
+
+        template<class Node>
+        static Node* leftmost(Node* n)
+        {
+            while (n->left != 0) {
+                n = n->left;
+            }
+            return n;
+        }
+    };
+
+    struct post_order {
+        template<class Node>
+        static Node* first(Node* root)
         {
+            return root != 0 ? left_deepest(root) : 0;
+        }
 
+        template<class Node>
+        static Node* next(Node* n)
+        {
+            assert(n != 0);
+            Node* prev = n;
+            n = n->parent();
+            if (n != 0 && prev == n->left && n->right != 0) {
+                return left_deepest(n->right);
+            }
+            return n;
         }
 
-        Node* left;
-        Node* right;
-        Node* parent;
-        Value v;
+        template<class Node>
+        static Node* left_deepest(Node* n)
+        {
+            while (true) {
+                if (n->left != 0) {
+                    n = n->left;
+                } else if (n->right != 0) {
+                    n = n->right;
+                } else {
+                    return n;
+                }
+            }
+        }
     };
+};
 
+// Forward iterator over the values of a tree in the order given by Traversal;
+// advancing it is a call to Traversal::next that the compiler can inline.
+template<class Node, class Value, class Traversal>
+class TTreeIterator : public std::iterator<std::forward_iterator_tag, Value> {
 public:
-    TBinaryTree() : 
-        root( 0 ),
-        sz( 0 )
+    explicit TTreeIterator(Node* _node) :
+        node( _node )
     {
     }
 
-    TBinaryTree(const TBinaryTree& other) : 
-        root( 0 ),
-        sz( 0 )
+    bool operator==(const TTreeIterator& other) const
     {
-        other.in_order_traverse( [this] (Value v) { this->insert(v); } ); 
+        return node == other.node;
     }
 
-    const TBinaryTree& operator=(const TBinaryTree& other)
+    bool operator!=(const TTreeIterator& other) const
     {
-        clear();        
-        other.in_order_traverse( [this] (Value v) { this->insert(v); } ); 
-        return other;
+        return node != other.node;
     }
 
-    TBinaryTree(TBinaryTree&& other) : 
-        root( 0 ),
-        sz( 0 )
+    const Value& operator*() const
     {
-        std::swap(root, other.root);
-        std::swap(sz, other.sz);
+        return node->v;
     }
 
-    void operator=(TBinaryTree&& other)
+    const Value* operator->() const
     {
-        clear();
-        std::swap(root, other.root);
-        std::swap(sz, other.sz);
+        return &node->v;
+    }
+
+    TTreeIterator& operator++() // prefix
+    {
+        node = Traversal::next(node);
+        return *this;
+    }
+
+    TTreeIterator operator++(int) // postfix
+    {
+        TTreeIterator ret = *this;
+        node = Traversal::next(node);
+        return ret;
     }
 
-    virtual ~TBinaryTree() 
+private:
+    Node* node;
+};
+
+// Everything the binary search trees share. The tree type Derived supplies
+// on_insert(Node*), called after a node is linked in,
+// internal_remove(Node**), which unlinks and destroys a node, and
+// on_build(Node*, bool), see assign_sorted. They are called through
+// static_cast, so there are no virtual functions.
+//
+// Nodes come from Alloc rebound to the node type. The default takes them
+// from the nvwa::static_mem_pool of the node size class; with TArenaAllocator
+// each tree carves its nodes from slabs of its own, and clear() and the
+// destructor hand the slabs back without visiting the nodes.
+template<class Derived, class Value, class Node, class Alloc>
+class TBinaryTreeBase {
+protected:
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Node> NodeAlloc;
+    typedef std::allocator_traits<NodeAlloc> NodeAllocTraits;
+
+public:
+    typedef TTreeIterator<Node, Value, tree_traversal::pre_order> PreOrderIterator;
+    typedef TTreeIterator<Node, Value, tree_traversal::in_order> InOrderIterator;
+    typedef TTreeIterator<Node, Value, tree_traversal::post_order> PostOrderIterator;
+
+    ~TBinaryTreeBase()
     {
         clear();
     }
@@ -79,11 +237,11 @@ public:
             } else {
                 parent->right = inserted;
             }
-            inserted->parent = parent;
+            inserted->set_parent(parent);
         } else {
             root = inserted = create_node(v);
         }
-        on_insert(inserted);
+        derived().on_insert(inserted);
         ++sz;
         return true;
     }
@@ -104,7 +262,7 @@ public:
         if (*n == 0) {
             return false;
         }
-        internal_remove(n);
+        derived().internal_remove(n);
         --sz;
         return true;
     }
@@ -114,267 +272,280 @@ public:
         return sz;
     }
 
+    // the first value not below v, found in O(depth)
+    InOrderIterator lower_bound(const Value& v) const
+    {
+        Node* bound = 0;
+        for (Node* n = root; n != 0; ) {
+            if (v > n->v) {
+                n = n->right;
+            } else {
+                bound = n;
+                n = n->left;
+            }
+        }
+        return InOrderIterator(bound);
+    }
+
+    // the first value above v
+    InOrderIterator upper_bound(const Value& v) const
+    {
+        Node* bound = 0;
+        for (Node* n = root; n != 0; ) {
+            if (n->v > v) {
+                bound = n;
+                n = n->left;
+            } else {
+                n = n->right;
+            }
+        }
+        return InOrderIterator(bound);
+    }
+
+    std::pair<InOrderIterator, InOrderIterator> equal_range(const Value& v) const
+    {
+        return std::make_pair(lower_bound(v), upper_bound(v));
+    }
+
+    // bytes of one node, without what the allocator adds per block
+    static size_t node_size()
+    {
+        return sizeof(Node);
+    }
+
+    // Walks the tree along the parent links, so it takes no memory and no
+    // stack however deep the tree is.
     int depth() const
     {
-        TSingleLinkedList<std::tuple<Node*, int>> stack;
         int result = 0, d = 1;
         Node* n = root;
         while (n != 0) {
             result = std::max(result, d);
             if (n->left != 0) {
-                stack.push_front(std::make_tuple(n, d));
                 n = n->left;
                 ++d;
             } else if (n->right != 0) {
                 n = n->right;
                 ++d;
             } else {
-                n = 0;
-                while (stack.size() > 0) {
-                    std::tie(n, d) = stack.pop_front();
-                    if ( n->right != 0 ) {
-                        n = n->right;
-                        ++d;
-                        break;
-                    } else {
-                        n = 0;
-                    }
+                // up to the nearest node whose right subtree is still to come
+                Node* prev = 0;
+                do {
+                    prev = n;
+                    n = n->parent();
+                    --d;
+                } while (n != 0 && (prev == n->right || n->right == 0));
+                if (n != 0) {
+                    n = n->right;
+                    ++d;
                 }
             }
         }
         return result;
     }
 
+    // The traversals follow the parent links like the iterators do, in
+    // constant memory on trees of any shape.
     template<class Func>
     void in_order_traverse(Func f) const
     {
-        internal_in_order_traverse(root, f);
+        internal_traverse<tree_traversal::in_order>(f);
     }
 
     template<class Func>
     void pre_order_traverse(Func f) const
     {
-        internal_pre_order_traverse(root, f);
+        internal_traverse<tree_traversal::pre_order>(f);
     }
 
     template<class Func>
     void post_order_traverse(Func f) const
     {
-        internal_post_order_traverse(root, f);
+        internal_traverse<tree_traversal::post_order>(f);
     }
 
     void clear()
     {
-        internal_clear(&root);
+        free_nodes(node_alloc, root);
+        root = 0;
+        sz = 0;
     }
 
-public:
-    class IteratorBase : public std::iterator<std::forward_iterator_tag, Value> {
-    public:
-        virtual ~IteratorBase()
-        {
-        }
-
-        bool operator==(const IteratorBase& other) 
-        {
-            return node == other.node;
-        }
-
-        bool operator!=(const IteratorBase& other) 
-        {
-            return !(node == other.node);
-        }
-
-        const Value& operator*() const 
-        {
-            return node->v;
-        }
-
-        IteratorBase& operator++() // prefix
-        {
-            advance();
-            return *this;
-        }
-
-    protected:
-        Node* node;
+    // Replaces the values with those of [first, last), which must be in
+    // strictly ascending order. The tree is built balanced in O(n) with no
+    // comparisons or rebalancing: the derived tree gets on_build(Node*,
+    // bool bottom) for every node, bottom if the node is on the last,
+    // incomplete level.
+    template<class Iterator>
+    void assign_sorted(Iterator first, Iterator last)
+    {
+        clear();
+        int n = std::distance(first, last);
+        root = build_sorted(first, n);
+        sz = n;
+    }
 
-        IteratorBase(Node* _node) : 
-            node( _node )
-        {
-        }
+    PreOrderIterator begin_preorder() const
+    {
+        return PreOrderIterator(tree_traversal::pre_order::first(root));
+    }
 
-        virtual void advance() = 0;
-    };
+    PreOrderIterator end_preorder() const
+    {
+        return PreOrderIterator(0);
+    }
 
-    class PreOrderIterator : public IteratorBase {
-    public:
-        PreOrderIterator(Node* _node) : 
-            IteratorBase( _node )
-        {
-        }
+    InOrderIterator begin_inorder() const
+    {
+        return InOrderIterator(tree_traversal::in_order::first(root));
+    }
 
-        virtual void advance()
-        {
-            assert(this->node != 0);
-            if (this->node->left != 0) {
-                this->node = this->node->left;
-            } else if (this->node->right != 0) {
-                this->node = this->node->right;
-            } else {
-                Node* prev = 0;
-                do {
-                    prev = this->node;
-                    this->node = this->node->parent;
-                } while (this->node != 0 && (prev == this->node->right || this->node->right == 0));
-                if (this->node != 0 && this->node->right != 0) {
-                    this->node = this->node->right;
-                }
-            }
-        }
-    };
+    InOrderIterator end_inorder() const
+    {
+        return InOrderIterator(0);
+    }
 
-    class InOrderIterator : public IteratorBase {
-    public:
-        InOrderIterator(Node* _node) : 
-            IteratorBase( _node )
-        {
-            if (this->node != 0) {
-                set_leftmost_child(this->node);
-            }
-        }
+    PostOrderIterator begin_postorder() const
+    {
+        return PostOrderIterator(tree_traversal::post_order::first(root));
+    }
 
-        virtual void advance() 
-        {
-            assert(this->node != 0);
-            if (this->node->right != 0) {
-                set_leftmost_child(this->node->right);
-            } else if (this->node->parent == 0) {
-                this->node = 0;
-            } else {
-                Node* prev = this->node;
-                do {
-                    prev = this->node;
-                    this->node = this->node->parent;
-                } while (this->node != 0 && prev == this->node->right);
-            }
-        }
+    PostOrderIterator end_postorder() const
+    {
+        return PostOrderIterator(0);
+    }
 
-    private:
-        void set_leftmost_child(Node* n)
-        {
-            assert( n != 0 );
-            while (n->left != 0) {
-                n = n->left;
-            }
-            this->node = n;
-        }
-    };
+protected:
+    NodeAlloc node_alloc;
+    Node* root;
+    int sz;
 
-    class PostOrderIterator : public IteratorBase {
-    public:
-        PostOrderIterator(Node* _node) : 
-            IteratorBase( _node )
-        {
-            if (this->node != 0) {
-               set_left_deepest_child(this->node);
-            }
-        }
+    TBinaryTreeBase() :
+        root( 0 ),
+        sz( 0 )
+    {
+    }
 
-        virtual void advance() 
-        {
-            assert(this->node != 0);
-            Node* prev = this->node;
-            this->node = this->node->parent;
-            if (this->node != 0 && prev == this->node->left && this->node->right != 0) {
-                set_left_deepest_child(this->node->right);
-            }
-        }
+    // copies the allocator only, the derived tree copies the values
+    TBinaryTreeBase(const TBinaryTreeBase& other) :
+        node_alloc( NodeAllocTraits::select_on_container_copy_construction(other.node_alloc) ),
+        root( 0 ),
+        sz( 0 )
+    {
+    }
 
-    private:
-        void set_left_deepest_child(Node* n)
-        {
-            assert( n != 0 );
-            while (true) {
-                if (n->left != 0) {
-                    n = n->left;
-                } else if (n->right != 0) {
-                    n = n->right;
-                } else {
-                    break;
-                }
-            }
-            this->node = n;
-        }
-    };
+    TBinaryTreeBase(TBinaryTreeBase&& other) :
+        node_alloc( std::move(other.node_alloc) ),
+        root( 0 ),
+        sz( 0 )
+    {
+        std::swap(root, other.root);
+        std::swap(sz, other.sz);
+    }
 
-    PreOrderIterator begin_preorder()
+    void assign(const TBinaryTreeBase& other)
     {
-        return PreOrderIterator(root);
+        if (this == &other) {
+            return;
+        }
+        assign_sorted(other.begin_inorder(), other.end_inorder());
     }
 
-    PreOrderIterator end_preorder()
+    void assign(TBinaryTreeBase&& other)
     {
-        return PreOrderIterator(0);
+        clear();
+        std::swap(node_alloc, other.node_alloc);
+        std::swap(root, other.root);
+        std::swap(sz, other.sz);
     }
 
-    InOrderIterator begin_inorder()
+    Derived& derived()
     {
-        return InOrderIterator(root);
+        return static_cast<Derived&>(*this);
     }
 
-    InOrderIterator end_inorder()
+    Node* create_node(const Value& v)
     {
-        return InOrderIterator(0);
+        Node* n = NodeAllocTraits::allocate(node_alloc, 1);
+        NodeAllocTraits::construct(node_alloc, n, v);
+        return n;
     }
 
-    PostOrderIterator begin_postorder()
+    void destroy_node(Node* n)
     {
-        return PostOrderIterator(root);
+        NodeAllocTraits::destroy(node_alloc, n);
+        NodeAllocTraits::deallocate(node_alloc, n, 1);
     }
 
-    PostOrderIterator end_postorder()
+    // Calls f on every node of the subtree at top, the children before
+    // their parent, without recursion. f may destroy the node it gets: the
+    // walk has moved past it by then.
+    template<class Func>
+    static void for_each_post_order(Node* top, Func f)
     {
-        return PostOrderIterator(0);
+        Node* n = tree_traversal::post_order::first(top);
+        while (n != 0) {
+            Node* next = n != top ? tree_traversal::post_order::next(n) : 0;
+            f(n);
+            n = next;
+        }
     }
 
-protected:
-    virtual Node* create_node(const Value& v)
+    template<class AnyAlloc>
+    void free_nodes(AnyAlloc&, Node* n)
     {
-        return new Node(v);
+        for_each_post_order(n, [this] (Node* m) { destroy_node(m); } );
     }
 
-    virtual void internal_clear(Node** r)
+    // the tree is the only user of its arena, so the slabs go back whole
+    template<class T>
+    void free_nodes(TArenaAllocator<T>& arena, Node* n)
     {
-        if(*r != 0) {
-            internal_clear(&(*r)->left);
-            internal_clear(&(*r)->right);
-            delete *r;
-            *r = 0;
+        if (!std::is_trivially_destructible<Value>::value) {
+            destroy_values(n);
         }
-        sz = 0;
+        arena.release();
     }
 
-    virtual void on_insert(Node* n)
+    void destroy_values(Node* n)
     {
+        for_each_post_order(n, [this] (Node* m) { NodeAllocTraits::destroy(node_alloc, m); } );
+    }
 
+    // a detached balanced subtree of the n values from first on
+    template<class Iterator>
+    Node* build_sorted(Iterator first, int n)
+    {
+        // levels 0..levels-2 are full, the last one is full only if n is 2^levels - 1
+        int levels = 0;
+        while ((1 << levels) - 1 < n) {
+            ++levels;
+        }
+        int bottom = ((1 << levels) - 1 == n) ? -1 : levels - 1;
+        return build_sorted(first, n, 0, bottom);
     }
 
-    virtual void internal_remove(Node** n) 
+    // n values from first on, as a subtree of nodes from depth on
+    template<class Iterator>
+    Node* build_sorted(Iterator& first, int n, int depth, int bottom)
     {
-        if ((*n)->left == 0) {
-            Node* tmp = *n;
-            *n = (*n)->right;
-            delete tmp;
-        } else if ((*n)->right == 0) {
-            Node* tmp = *n;
-            *n = (*n)->left;
-            delete tmp;
-        } else {
-            Node** d = leftmost_descendant(&(*n)->right);
-            (*n)->v = (*d)->v;
-            internal_remove(d);
+        if (n == 0) {
+            return 0;
+        }
+        int left_n = (n - 1) / 2;
+        Node* left = build_sorted(first, left_n, depth + 1, bottom);
+        Node* node = create_node(*first);
+        ++first;
+        node->left = left;
+        if (left != 0) {
+            left->set_parent(node);
+        }
+        node->right = build_sorted(first, n - 1 - left_n, depth + 1, bottom);
+        if (node->right != 0) {
+            node->right->set_parent(node);
         }
+        derived().on_build(node, depth == bottom);
+        return node;
     }
 
     Node** leftmost_descendant(Node** n)
@@ -386,10 +557,6 @@ protected:
         return n;
     }
 
-protected:
-    Node* root;
-    int sz;
-
 private:
     Node** internal_find(const Value& v)
     {
@@ -407,9 +574,9 @@ private:
         return n;
     }
 
-    Node** internal_find(const Value& v) const 
+    Node** internal_find(const Value& v) const
     {
-        return const_cast<TBinaryTree*>(this)->internal_find(v);
+        return const_cast<TBinaryTreeBase*>(this)->internal_find(v);
     }
 
     Node* internal_find_ins_parent(const Value& v)
@@ -432,34 +599,77 @@ private:
         return n;
     }
 
-    template<class Func>
-    void internal_in_order_traverse(Node* n, Func f) const
+    template<class Traversal, class Func>
+    void internal_traverse(Func& f) const
     {
-        if (n != 0) {
-            internal_in_order_traverse(n->left, f);
+        for (Node* n = Traversal::first(root); n != 0; n = Traversal::next(n)) {
             f(n->v);
-            internal_in_order_traverse(n->right, f);
         }
     }
 
-    template<class Func>
-    void internal_pre_order_traverse(Node* n, Func f) const
+};
+
+// Plain, unbalanced binary search tree.
+template<class Value, class Alloc = TPoolAllocator<Value>>
+class TBinaryTree : public TBinaryTreeBase<TBinaryTree<Value, Alloc>, Value, TBinaryTreeNode<Value>, Alloc> {
+    friend class TBinaryTreeBase<TBinaryTree, Value, TBinaryTreeNode<Value>, Alloc>;
+
+public:
+    typedef TBinaryTreeBase<TBinaryTree, Value, TBinaryTreeNode<Value>, Alloc> ParentClass;
+
+    TBinaryTree()
     {
-        if (n != 0) {
-            f(n->v);
-            internal_pre_order_traverse(n->left, f);
-            internal_pre_order_traverse(n->right, f);
-        }
     }
 
-    template<class Func>
-    void internal_post_order_traverse(Node* n, Func f) const
+    TBinaryTree(const TBinaryTree& other) :
+        ParentClass( other )
     {
-        if (n != 0) {
-            internal_post_order_traverse(n->left, f);
-            internal_post_order_traverse(n->right, f);
-            f(n->v);
-        }
+        this->assign(other);
+    }
+
+    const TBinaryTree& operator=(const TBinaryTree& other)
+    {
+        this->assign(other);
+        return other;
+    }
+
+    TBinaryTree(TBinaryTree&& other) :
+        ParentClass( std::move(other) )
+    {
+    }
+
+    void operator=(TBinaryTree&& other)
+    {
+        this->assign(std::move(other));
+    }
+
+protected:
+    typedef TBinaryTreeNode<Value> Node;
+
+    void on_insert(Node* n)
+    {
+
+    }
+
+    void on_build(Node* n, bool bottom)
+    {
+
     }
 
+    void internal_remove(Node** n)
+    {
+        if ((*n)->left == 0 || (*n)->right == 0) {
+            Node* tmp = *n;
+            Node* child = (tmp->left == 0) ? tmp->right : tmp->left;
+            if (child != 0) {
+                child->set_parent(tmp->parent());
+            }
+            *n = child;
+            this->destroy_node(tmp);
+        } else {
+            Node** d = this->leftmost_descendant(&(*n)->right);
+            (*n)->v = (*d)->v;
+            internal_remove(d);
+        }
+    }
 };
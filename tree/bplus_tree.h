@@ -0,0 +1,773 @@
+#pragma once
+#include <assert.h>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <arena_allocator.h>
+#include <pool_allocator.h>
+#include <debug_new.h>
+
+// As many keys as fit in a node of NodeBytes bytes, but at least three, so
+// that both halves of a split node are non-empty. A leaf holds its count,
+// the link to the next leaf and the values; an inner node its count, the
+// separator keys and one child more than keys.
+template<class Value, int NodeBytes = 256>
+struct bplus_tree_capacity {
+    static const int leaf_fitting = (NodeBytes - 2 * sizeof(void*)) / sizeof(Value);
+    static const int inner_fitting = (NodeBytes - sizeof(int) - sizeof(void*)) / (sizeof(Value) + sizeof(void*));
+    static const int leaf = leaf_fitting < 3 ? 3 : leaf_fitting;
+    static const int inner = inner_fitting < 3 ? 3 : inner_fitting;
+};
+
+// B+ tree with the interface of the binary search trees, so it can back a
+// TSingleSet. All values are in the leaves, which are linked in order for
+// the in-order walk; inner nodes hold copies of values as separators: the
+// values under children[i] are below keys[i], those under children[i + 1]
+// are not. Keys are scanned linearly with a branch-free count, which the
+// compiler can vectorise, and a node spans a few cache lines, so a lookup
+// touches a handful of nodes instead of one node per level of a binary tree.
+// Value needs a default constructor, and < and == on values.
+//
+// Nodes come from Alloc rebound to the leaf and to the inner node type.
+// With TArenaAllocator clear() and the destructor hand the slabs back
+// without visiting the nodes, as in the binary trees.
+template<class Value, class Alloc = TPoolAllocator<Value>,
+         int LeafCapacity = bplus_tree_capacity<Value>::leaf,
+         int InnerCapacity = bplus_tree_capacity<Value>::inner>
+class TBPlusTree {
+    static_assert(LeafCapacity >= 3 && InnerCapacity >= 3, "a node must hold at least three keys");
+
+    struct Node;
+    struct Leaf;
+    struct Inner;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Leaf> LeafAlloc;
+    typedef std::allocator_traits<LeafAlloc> LeafAllocTraits;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Inner> InnerAlloc;
+    typedef std::allocator_traits<InnerAlloc> InnerAllocTraits;
+
+public:
+    class InOrderIterator;
+
+    TBPlusTree()
+    {
+        initialize();
+    }
+
+    TBPlusTree(const TBPlusTree& other) :
+        leaf_alloc( LeafAllocTraits::select_on_container_copy_construction(other.leaf_alloc) ),
+        inner_alloc( InnerAllocTraits::select_on_container_copy_construction(other.inner_alloc) )
+    {
+        initialize();
+        *this = other;
+    }
+
+    TBPlusTree(TBPlusTree&& other) :
+        leaf_alloc( std::move(other.leaf_alloc) ),
+        inner_alloc( std::move(other.inner_alloc) )
+    {
+        initialize();
+        swap_nodes(other);
+    }
+
+    ~TBPlusTree()
+    {
+        clear();
+    }
+
+    // copies the shape of other node by node, no splits
+    const TBPlusTree& operator=(const TBPlusTree& other)
+    {
+        if (this == &other) {
+            return other;
+        }
+        clear();
+        if (other.root != 0) {
+            Leaf* last = 0;
+            root = clone(other.root, other.height, last);
+            height = other.height;
+            sz = other.sz;
+        }
+        return other;
+    }
+
+    void operator=(TBPlusTree&& other)
+    {
+        clear();
+        std::swap(leaf_alloc, other.leaf_alloc);
+        std::swap(inner_alloc, other.inner_alloc);
+        swap_nodes(other);
+    }
+
+    bool insert(const Value& v)
+    {
+        if (root == 0) {
+            Leaf* leaf = create_leaf();
+            leaf->keys[0] = v;
+            leaf->count = 1;
+            root = leaf;
+            ++sz;
+            return true;
+        }
+        Value separator;
+        Node* split = 0;
+        if (!insert_into(root, height, v, separator, split)) {
+            return false;
+        }
+        if (split != 0) {
+            Inner* new_root = create_inner();
+            new_root->keys[0] = std::move(separator);
+            new_root->children[0] = root;
+            new_root->children[1] = split;
+            new_root->count = 1;
+            root = new_root;
+            ++height;
+        }
+        ++sz;
+        return true;
+    }
+
+    bool find(const Value& v) const
+    {
+        const Leaf* leaf = find_leaf(v);
+        if (leaf == 0) {
+            return false;
+        }
+        int pos = count_less(leaf->keys, leaf->count, v);
+        return pos < leaf->count && leaf->keys[pos] == v;
+    }
+
+    bool remove(const Value& v)
+    {
+        if (root == 0 || !remove_from(root, height, v)) {
+            return false;
+        }
+        --sz;
+        if (height > 0 && root->count == 0) {
+            Inner* old_root = static_cast<Inner*>(root);
+            root = old_root->children[0];
+            destroy_inner(old_root);
+            --height;
+        } else if (height == 0 && root->count == 0) {
+            destroy_leaf(static_cast<Leaf*>(root));
+            root = 0;
+        }
+        return true;
+    }
+
+    int size() const
+    {
+        return sz;
+    }
+
+    // number of levels, all leaves are on the last one
+    int depth() const
+    {
+        return root != 0 ? height + 1 : 0;
+    }
+
+    template<class Func>
+    void in_order_traverse(Func f) const
+    {
+        for (const Leaf* leaf = first_leaf(); leaf != 0; leaf = leaf->next) {
+            for (int i = 0; i < leaf->count; ++i) {
+                f(leaf->keys[i]);
+            }
+        }
+    }
+
+    void clear()
+    {
+        free_nodes(leaf_alloc);
+        initialize();
+    }
+
+    // Replaces the values with those of [first, last), which must be in
+    // strictly ascending order, in O(n) with no splits. The values are
+    // spread evenly over as few levels as hold them, so the nodes are
+    // between half and completely full.
+    template<class Iterator>
+    void assign_sorted(Iterator first, Iterator last)
+    {
+        clear();
+        int n = std::distance(first, last);
+        if (n == 0) {
+            return;
+        }
+        while (subtree_capacity(height) < n) {
+            ++height;
+        }
+        Leaf* last_leaf = 0;
+        Value lowest;
+        root = build_sorted(first, n, height, last_leaf, lowest);
+        sz = n;
+    }
+
+    InOrderIterator begin_inorder() const
+    {
+        return InOrderIterator(first_leaf(), 0);
+    }
+
+    InOrderIterator end_inorder() const
+    {
+        return InOrderIterator(0, 0);
+    }
+
+    // the first value not below v, found in O(depth)
+    InOrderIterator lower_bound(const Value& v) const
+    {
+        const Leaf* leaf = find_leaf(v);
+        return leaf != 0 ? position(leaf, count_less(leaf->keys, leaf->count, v)) : end_inorder();
+    }
+
+    // the first value above v
+    InOrderIterator upper_bound(const Value& v) const
+    {
+        const Leaf* leaf = find_leaf(v);
+        return leaf != 0 ? position(leaf, count_not_greater(leaf->keys, leaf->count, v)) : end_inorder();
+    }
+
+    std::pair<InOrderIterator, InOrderIterator> equal_range(const Value& v) const
+    {
+        return std::make_pair(lower_bound(v), upper_bound(v));
+    }
+
+    // checks the ordering, the occupancy of the nodes, that all leaves are
+    // on one level and that the leaf links visit every value once
+    bool bplus_satisfied() const
+    {
+        if (root == 0) {
+            return sz == 0;
+        }
+        const Leaf* leaf = first_leaf();
+        if (!satisfied(root, height, 0, 0, leaf)) {
+            return false;
+        }
+        if (leaf != 0) {
+            return false;
+        }
+        int counted = 0;
+        in_order_traverse( [&counted] (const Value&) { ++counted; } );
+        return counted == sz;
+    }
+
+    class InOrderIterator : public std::iterator<std::forward_iterator_tag, Value> {
+    friend class TBPlusTree;
+    public:
+        bool operator==(const InOrderIterator& other) const
+        {
+            return leaf == other.leaf && index == other.index;
+        }
+
+        bool operator!=(const InOrderIterator& other) const
+        {
+            return !(*this == other);
+        }
+
+        const Value& operator*() const
+        {
+            assert(leaf != 0);
+            return leaf->keys[index];
+        }
+
+        const Value* operator->() const
+        {
+            assert(leaf != 0);
+            return &leaf->keys[index];
+        }
+
+        InOrderIterator& operator++() // prefix
+        {
+            if (++index == leaf->count) {
+                leaf = leaf->next;
+                index = 0;
+            }
+            return *this;
+        }
+
+        InOrderIterator operator++(int) // postfix
+        {
+            InOrderIterator ret = *this;
+            ++*this;
+            return ret;
+        }
+
+    private:
+        InOrderIterator(const Leaf* _leaf, int _index) :
+            leaf( _leaf ),
+            index( _index )
+        {
+        }
+
+        const Leaf* leaf;
+        int index;
+    };
+
+private:
+    struct Node {
+        Node() :
+            count( 0 )
+        {
+        }
+
+        int count;
+    };
+
+    struct Leaf : Node {
+        Leaf() :
+            next( 0 )
+        {
+        }
+
+        Leaf* next;
+        Value keys[LeafCapacity];
+    };
+
+    struct Inner : Node {
+        Value keys[InnerCapacity];
+        Node* children[InnerCapacity + 1];
+    };
+
+    LeafAlloc leaf_alloc;
+    InnerAlloc inner_alloc;
+    Node* root;
+    // number of inner levels above the leaves
+    int height;
+    int sz;
+
+    void initialize()
+    {
+        root = 0;
+        height = 0;
+        sz = 0;
+    }
+
+    void swap_nodes(TBPlusTree& other)
+    {
+        std::swap(root, other.root);
+        std::swap(height, other.height);
+        std::swap(sz, other.sz);
+    }
+
+    // fewest keys a node other than the root may hold
+    static int min_count(int level)
+    {
+        return level == 0 ? LeafCapacity / 2 : InnerCapacity / 2;
+    }
+
+    // number of keys below v, the position of v in a leaf
+    static int count_less(const Value* keys, int count, const Value& v)
+    {
+        int n = 0;
+        for (int i = 0; i < count; ++i) {
+            n += keys[i] < v;
+        }
+        return n;
+    }
+
+    // number of keys not above v, the child of an inner node to descend to
+    static int count_not_greater(const Value* keys, int count, const Value& v)
+    {
+        int n = 0;
+        for (int i = 0; i < count; ++i) {
+            n += !(v < keys[i]);
+        }
+        return n;
+    }
+
+    template<class T>
+    static void insert_at(T* items, int count, int pos, T&& item)
+    {
+        std::move_backward(items + pos, items + count, items + count + 1);
+        items[pos] = std::move(item);
+    }
+
+    template<class T>
+    static void erase_at(T* items, int count, int pos)
+    {
+        std::move(items + pos + 1, items + count, items + pos);
+    }
+
+    // the leaf v belongs in, 0 in an empty tree
+    const Leaf* find_leaf(const Value& v) const
+    {
+        const Node* n = root;
+        for (int level = height; level > 0; --level) {
+            const Inner* inner = static_cast<const Inner*>(n);
+            n = inner->children[count_not_greater(inner->keys, inner->count, v)];
+        }
+        return static_cast<const Leaf*>(n);
+    }
+
+    // an iterator at index in leaf, which may be one past its last value
+    static InOrderIterator position(const Leaf* leaf, int index)
+    {
+        if (index == leaf->count) {
+            return InOrderIterator(leaf->next, 0);
+        }
+        return InOrderIterator(leaf, index);
+    }
+
+    const Leaf* first_leaf() const
+    {
+        const Node* n = root;
+        for (int level = height; level > 0 && n != 0; --level) {
+            n = static_cast<const Inner*>(n)->children[0];
+        }
+        return static_cast<const Leaf*>(n);
+    }
+
+    // Inserts v under n, level levels above the leaves. If n had to be
+    // split, split is the new right sibling and separator its lowest value.
+    bool insert_into(Node* n, int level, const Value& v, Value& separator, Node*& split)
+    {
+        if (level == 0) {
+            Leaf* leaf = static_cast<Leaf*>(n);
+            int pos = count_less(leaf->keys, leaf->count, v);
+            if (pos < leaf->count && leaf->keys[pos] == v) {
+                return false;
+            }
+            if (leaf->count < LeafCapacity) {
+                insert_at(leaf->keys, leaf->count++, pos, Value(v));
+                return true;
+            }
+            const int mid = LeafCapacity / 2;
+            Leaf* right = create_leaf();
+            std::move(leaf->keys + mid, leaf->keys + LeafCapacity, right->keys);
+            right->count = LeafCapacity - mid;
+            leaf->count = mid;
+            if (pos <= mid) {
+                insert_at(leaf->keys, leaf->count++, pos, Value(v));
+            } else {
+                insert_at(right->keys, right->count++, pos - mid, Value(v));
+            }
+            right->next = leaf->next;
+            leaf->next = right;
+            separator = right->keys[0];
+            split = right;
+            return true;
+        }
+
+        Inner* inner = static_cast<Inner*>(n);
+        int i = count_not_greater(inner->keys, inner->count, v);
+        Value child_separator;
+        Node* child_split = 0;
+        if (!insert_into(inner->children[i], level - 1, v, child_separator, child_split)) {
+            return false;
+        }
+        if (child_split == 0) {
+            return true;
+        }
+        if (inner->count < InnerCapacity) {
+            insert_child(inner, i, std::move(child_separator), child_split);
+            return true;
+        }
+        // of the InnerCapacity + 1 keys half stay, one moves up and the
+        // rest go right, so both halves have at least the minimum
+        const int half = InnerCapacity / 2;
+        Inner* right = create_inner();
+        if (i == half) {
+            std::move(inner->keys + half, inner->keys + InnerCapacity, right->keys);
+            right->children[0] = child_split;
+            std::copy(inner->children + half + 1, inner->children + InnerCapacity + 1, right->children + 1);
+            right->count = InnerCapacity - half;
+            separator = std::move(child_separator);
+            inner->count = half;
+        } else {
+            const int mid = i < half ? half - 1 : half;
+            std::move(inner->keys + mid + 1, inner->keys + InnerCapacity, right->keys);
+            std::copy(inner->children + mid + 1, inner->children + InnerCapacity + 1, right->children);
+            right->count = InnerCapacity - mid - 1;
+            separator = std::move(inner->keys[mid]);
+            inner->count = mid;
+            if (i < half) {
+                insert_child(inner, i, std::move(child_separator), child_split);
+            } else {
+                insert_child(right, i - mid - 1, std::move(child_separator), child_split);
+            }
+        }
+        split = right;
+        return true;
+    }
+
+    // children[i] was split into itself and child, separated by key
+    static void insert_child(Inner* inner, int i, Value&& key, Node* child)
+    {
+        insert_at(inner->keys, inner->count, i, std::move(key));
+        insert_at(inner->children, inner->count + 1, i + 1, std::move(child));
+        ++inner->count;
+    }
+
+    bool remove_from(Node* n, int level, const Value& v)
+    {
+        if (level == 0) {
+            Leaf* leaf = static_cast<Leaf*>(n);
+            int pos = count_less(leaf->keys, leaf->count, v);
+            if (pos == leaf->count || !(leaf->keys[pos] == v)) {
+                return false;
+            }
+            erase_at(leaf->keys, leaf->count--, pos);
+            return true;
+        }
+        Inner* inner = static_cast<Inner*>(n);
+        int i = count_not_greater(inner->keys, inner->count, v);
+        if (!remove_from(inner->children[i], level - 1, v)) {
+            return false;
+        }
+        if (inner->children[i]->count < min_count(level - 1)) {
+            refill_child(inner, i, level - 1);
+        }
+        return true;
+    }
+
+    // children[i] of p is one below the minimum: it borrows from a sibling
+    // that can spare a key or is merged with one
+    void refill_child(Inner* p, int i, int child_level)
+    {
+        const int min = min_count(child_level);
+        Node* left = i > 0 ? p->children[i - 1] : 0;
+        Node* right = i < p->count ? p->children[i + 1] : 0;
+        if (left != 0 && left->count > min) {
+            borrow_from_left(p, i, child_level);
+        } else if (right != 0 && right->count > min) {
+            borrow_from_right(p, i, child_level);
+        } else if (left != 0) {
+            merge_children(p, i - 1, child_level);
+        } else {
+            merge_children(p, i, child_level);
+        }
+    }
+
+    void borrow_from_left(Inner* p, int i, int child_level)
+    {
+        if (child_level == 0) {
+            Leaf* child = static_cast<Leaf*>(p->children[i]);
+            Leaf* left = static_cast<Leaf*>(p->children[i - 1]);
+            insert_at(child->keys, child->count++, 0, std::move(left->keys[--left->count]));
+            p->keys[i - 1] = child->keys[0];
+        } else {
+            Inner* child = static_cast<Inner*>(p->children[i]);
+            Inner* left = static_cast<Inner*>(p->children[i - 1]);
+            insert_at(child->keys, child->count, 0, std::move(p->keys[i - 1]));
+            insert_at(child->children, child->count + 1, 0, std::move(left->children[left->count]));
+            ++child->count;
+            p->keys[i - 1] = std::move(left->keys[--left->count]);
+        }
+    }
+
+    void borrow_from_right(Inner* p, int i, int child_level)
+    {
+        if (child_level == 0) {
+            Leaf* child = static_cast<Leaf*>(p->children[i]);
+            Leaf* right = static_cast<Leaf*>(p->children[i + 1]);
+            child->keys[child->count++] = std::move(right->keys[0]);
+            erase_at(right->keys, right->count--, 0);
+            p->keys[i] = right->keys[0];
+        } else {
+            Inner* child = static_cast<Inner*>(p->children[i]);
+            Inner* right = static_cast<Inner*>(p->children[i + 1]);
+            child->keys[child->count] = std::move(p->keys[i]);
+            child->children[child->count + 1] = right->children[0];
+            ++child->count;
+            p->keys[i] = std::move(right->keys[0]);
+            erase_at(right->keys, right->count, 0);
+            erase_at(right->children, right->count + 1, 0);
+            --right->count;
+        }
+    }
+
+    // moves children[i + 1] of p into children[i] and drops it
+    void merge_children(Inner* p, int i, int child_level)
+    {
+        if (child_level == 0) {
+            Leaf* left = static_cast<Leaf*>(p->children[i]);
+            Leaf* right = static_cast<Leaf*>(p->children[i + 1]);
+            std::move(right->keys, right->keys + right->count, left->keys + left->count);
+            left->count += right->count;
+            left->next = right->next;
+            destroy_leaf(right);
+        } else {
+            Inner* left = static_cast<Inner*>(p->children[i]);
+            Inner* right = static_cast<Inner*>(p->children[i + 1]);
+            left->keys[left->count] = std::move(p->keys[i]);
+            std::move(right->keys, right->keys + right->count, left->keys + left->count + 1);
+            std::copy(right->children, right->children + right->count + 1, left->children + left->count + 1);
+            left->count += right->count + 1;
+            destroy_inner(right);
+        }
+        erase_at(p->keys, p->count, i);
+        erase_at(p->children, p->count + 1, i + 1);
+        --p->count;
+    }
+
+    // most values a subtree level levels above the leaves can hold
+    static long long subtree_capacity(int level)
+    {
+        long long capacity = LeafCapacity;
+        for (; level > 0; --level) {
+            capacity *= InnerCapacity + 1;
+        }
+        return capacity;
+    }
+
+    // n values from first on, in as many children as needed, each with an
+    // even share; lowest is set to the first value, the separator above
+    template<class Iterator>
+    Node* build_sorted(Iterator& first, int n, int level, Leaf*& last, Value& lowest)
+    {
+        if (level == 0) {
+            Leaf* leaf = create_leaf();
+            for (int i = 0; i < n; ++i, ++first) {
+                leaf->keys[i] = *first;
+            }
+            leaf->count = n;
+            if (last != 0) {
+                last->next = leaf;
+            }
+            last = leaf;
+            lowest = leaf->keys[0];
+            return leaf;
+        }
+        long long below = subtree_capacity(level - 1);
+        int children = (n + below - 1) / below;
+        Inner* inner = create_inner();
+        for (int i = 0; i < children; ++i) {
+            int share = n / children + (i < n % children ? 1 : 0);
+            Value child_lowest;
+            inner->children[i] = build_sorted(first, share, level - 1, last, child_lowest);
+            if (i > 0) {
+                inner->keys[i - 1] = std::move(child_lowest);
+            } else {
+                lowest = std::move(child_lowest);
+            }
+        }
+        inner->count = children - 1;
+        return inner;
+    }
+
+    // last is the leaf cloned before n's first leaf, it is linked to it
+    Node* clone(const Node* n, int level, Leaf*& last)
+    {
+        if (level == 0) {
+            const Leaf* leaf = static_cast<const Leaf*>(n);
+            Leaf* copy = create_leaf();
+            std::copy(leaf->keys, leaf->keys + leaf->count, copy->keys);
+            copy->count = leaf->count;
+            if (last != 0) {
+                last->next = copy;
+            }
+            last = copy;
+            return copy;
+        }
+        const Inner* inner = static_cast<const Inner*>(n);
+        Inner* copy = create_inner();
+        std::copy(inner->keys, inner->keys + inner->count, copy->keys);
+        for (int i = 0; i <= inner->count; ++i) {
+            copy->children[i] = clone(inner->children[i], level - 1, last);
+        }
+        copy->count = inner->count;
+        return copy;
+    }
+
+    // the values under n are in [low, high), a null bound is open
+    bool satisfied(const Node* n, int level, const Value* low, const Value* high, const Leaf*& leaf) const
+    {
+        if (n != root && n->count < min_count(level)) {
+            return false;
+        }
+        const Value* keys = level == 0 ? static_cast<const Leaf*>(n)->keys : static_cast<const Inner*>(n)->keys;
+        for (int i = 0; i < n->count; ++i) {
+            if ((i > 0 && !(keys[i - 1] < keys[i])) || (low != 0 && keys[i] < *low) || (high != 0 && !(keys[i] < *high))) {
+                return false;
+            }
+        }
+        if (level == 0) {
+            if (n != leaf) {
+                return false;
+            }
+            leaf = leaf->next;
+            return true;
+        }
+        const Inner* inner = static_cast<const Inner*>(n);
+        for (int i = 0; i <= inner->count; ++i) {
+            const Value* child_low = i > 0 ? &inner->keys[i - 1] : low;
+            const Value* child_high = i < inner->count ? &inner->keys[i] : high;
+            if (!satisfied(inner->children[i], level - 1, child_low, child_high, leaf)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Leaf* create_leaf()
+    {
+        Leaf* leaf = LeafAllocTraits::allocate(leaf_alloc, 1);
+        LeafAllocTraits::construct(leaf_alloc, leaf);
+        return leaf;
+    }
+
+    Inner* create_inner()
+    {
+        Inner* inner = InnerAllocTraits::allocate(inner_alloc, 1);
+        InnerAllocTraits::construct(inner_alloc, inner);
+        return inner;
+    }
+
+    void destroy_leaf(Leaf* leaf)
+    {
+        LeafAllocTraits::destroy(leaf_alloc, leaf);
+        LeafAllocTraits::deallocate(leaf_alloc, leaf, 1);
+    }
+
+    void destroy_inner(Inner* inner)
+    {
+        InnerAllocTraits::destroy(inner_alloc, inner);
+        InnerAllocTraits::deallocate(inner_alloc, inner, 1);
+    }
+
+    template<class AnyAlloc>
+    void free_nodes(AnyAlloc&)
+    {
+        if (root != 0) {
+            destroy_subtree(root, height);
+        }
+    }
+
+    // the tree is the only user of its arenas, so the slabs go back whole
+    template<class T>
+    void free_nodes(TArenaAllocator<T>& arena)
+    {
+        if (!std::is_trivially_destructible<Value>::value && root != 0) {
+            destroy_values(root, height);
+        }
+        arena.release();
+        inner_alloc.release();
+    }
+
+    void destroy_subtree(Node* n, int level)
+    {
+        if (level == 0) {
+            destroy_leaf(static_cast<Leaf*>(n));
+            return;
+        }
+        Inner* inner = static_cast<Inner*>(n);
+        for (int i = 0; i <= inner->count; ++i) {
+            destroy_subtree(inner->children[i], level - 1);
+        }
+        destroy_inner(inner);
+    }
+
+    void destroy_values(Node* n, int level)
+    {
+        if (level == 0) {
+            LeafAllocTraits::destroy(leaf_alloc, static_cast<Leaf*>(n));
+            return;
+        }
+        Inner* inner = static_cast<Inner*>(n);
+        for (int i = 0; i <= inner->count; ++i) {
+            destroy_values(inner->children[i], level - 1);
+        }
+        InnerAllocTraits::destroy(inner_alloc, inner);
+    }
+};
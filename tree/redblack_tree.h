@@ -1,10 +1,111 @@
 #pragma once
+#include <cstdint>
+#include <thread>
+#include <type_traits>
 #include <binary_tree.h>
 
+// The value of a red-black tree node and, for an order-statistic tree,
+// the number of nodes in its subtree. The count goes next to the value, so
+// after a 4-byte value it takes no space of its own.
+template<class Value, bool Counted>
+class TRedBlackTreeNodeValue {
+public:
+    TRedBlackTreeNodeValue(const Value& _v) :
+        v( _v )
+    {
+    }
+
+    int subtree_count() const
+    {
+        return 0;
+    }
+
+    void set_subtree_count(int)
+    {
+    }
+
+    Value v;
+};
+
 template<class Value>
-class TRedBlackTree : private TBinaryTree<Value> {
+class TRedBlackTreeNodeValue<Value, true> {
+public:
+    TRedBlackTreeNodeValue(const Value& _v) :
+        v( _v ),
+        count( 1 )
+    {
+    }
+
+    int subtree_count() const
+    {
+        return count;
+    }
+
+    void set_subtree_count(int _count)
+    {
+        count = _count;
+    }
+
+    Value v;
+
+private:
+    int count;
+};
+
+// Red-black tree node with the colour in the low bit of the parent link.
+// Nodes hold pointers, so a node address never has that bit set, and the
+// colour costs no space: with a separate bool a node of three links and an
+// 8-byte value would be padded from 32 to 40 bytes.
+template<class Value, bool Counted = false>
+class TRedBlackTreeNode : public TRedBlackTreeNodeValue<Value, Counted> {
 public:
-    typedef TBinaryTree<Value> ParentClass;
+    TRedBlackTreeNode(const Value& _v) :
+        TRedBlackTreeNodeValue<Value, Counted>( _v ),
+        left( 0 ),
+        right( 0 ),
+        parent_and_colour( red_bit )
+    {
+        static_assert(alignof(TRedBlackTreeNode) > red_bit, "the colour bit must be free in node addresses");
+    }
+
+    TRedBlackTreeNode* parent() const
+    {
+        return reinterpret_cast<TRedBlackTreeNode*>(parent_and_colour & ~red_bit);
+    }
+
+    void set_parent(TRedBlackTreeNode* p)
+    {
+        parent_and_colour = reinterpret_cast<uintptr_t>(p) | (parent_and_colour & red_bit);
+    }
+
+    bool is_red() const
+    {
+        return (parent_and_colour & red_bit) != 0;
+    }
+
+    void set_red(bool red)
+    {
+        parent_and_colour = (parent_and_colour & ~red_bit) | (red ? red_bit : 0);
+    }
+
+    TRedBlackTreeNode* left;
+    TRedBlackTreeNode* right;
+
+private:
+    static const uintptr_t red_bit = 1;
+
+    uintptr_t parent_and_colour;
+};
+
+// With OrderStatistics every node also counts the nodes of its subtree,
+// which gives select, rank and count_range in O(log n) for 4 more bytes a
+// node (none after a 4-byte value) and a little work on every change.
+template<class Value, class Alloc = TPoolAllocator<Value>, bool OrderStatistics = false>
+class TRedBlackTree : private TBinaryTreeBase<TRedBlackTree<Value, Alloc, OrderStatistics>, Value, TRedBlackTreeNode<Value, OrderStatistics>, Alloc> {
+    friend class TBinaryTreeBase<TRedBlackTree, Value, TRedBlackTreeNode<Value, OrderStatistics>, Alloc>;
+
+public:
+    typedef TBinaryTreeBase<TRedBlackTree, Value, TRedBlackTreeNode<Value, OrderStatistics>, Alloc> ParentClass;
 
     TRedBlackTree() : 
         ParentClass()
@@ -12,35 +113,25 @@ public:
     }
 
     TRedBlackTree(const TRedBlackTree& other) : 
-        TBinaryTree<Value>()
+        ParentClass( other )
     {
-        other.in_order_traverse( [this] (Value v) { this->insert(v); } ); 
+        this->assign(other);
     }
 
     const TRedBlackTree& operator=(const TRedBlackTree& other)
     {
-        clear();        
-        other.in_order_traverse( [this] (Value v) { this->insert(v); } ); 
+        this->assign(other);
         return other;
     }
 
     TRedBlackTree(TRedBlackTree&& other) : 
-        TBinaryTree<Value>()
+        ParentClass( std::move(other) )
     {
-        std::swap(this->root, other.root);
-        std::swap(this->sz, other.sz);
     }
 
     void operator=(TRedBlackTree&& other)
     {
-        clear();
-        std::swap(this->root, other.root);
-        std::swap(this->sz, other.sz);
-    }
-
-    virtual ~TRedBlackTree() 
-    {
-        clear();
+        this->assign(std::move(other));
     }
 
     using ParentClass::insert;
@@ -51,7 +142,12 @@ public:
     using ParentClass::pre_order_traverse;
     using ParentClass::post_order_traverse;
     using ParentClass::find;
+    using ParentClass::lower_bound;
+    using ParentClass::upper_bound;
+    using ParentClass::equal_range;
     using ParentClass::clear;
+    using ParentClass::assign_sorted;
+    using ParentClass::node_size;
     using typename ParentClass::PreOrderIterator;
     using ParentClass::begin_preorder;
     using ParentClass::end_preorder;
@@ -64,108 +160,194 @@ public:
 
     bool rbt_satisfied()
     {
-        RBTNode* r = reinterpret_cast<RBTNode*>(this->root);
+        RBTNode* r = this->root;
         if (r == 0) {
             return true;
         }
-        if (r->red) {
+        if (r->is_red()) {
             return false;
         }
         int bn_path = 0;
         return rbt_satisfied(r, bn_path);
     }
 
-protected:
-    typedef typename TBinaryTree<Value>::Node ParentNodeClass;
+    // the k-th smallest value, k from 0
+    const Value& select(int k) const
+    {
+        static_assert(OrderStatistics, "select needs an order-statistic tree");
+        assert(k >= 0 && k < this->sz);
+        RBTNode* n = this->root;
+        while (true) {
+            int left = count_of(n->left);
+            if (k < left) {
+                n = n->left;
+            } else if (k == left) {
+                return n->v;
+            } else {
+                k -= left + 1;
+                n = n->right;
+            }
+        }
+    }
+
+    // number of values below v
+    int rank(const Value& v) const
+    {
+        static_assert(OrderStatistics, "rank needs an order-statistic tree");
+        int below = 0;
+        RBTNode* n = this->root;
+        while (n != 0) {
+            if (n->v > v) {
+                n = n->left;
+            } else if (n->v == v) {
+                return below + count_of(n->left);
+            } else {
+                below += count_of(n->left) + 1;
+                n = n->right;
+            }
+        }
+        return below;
+    }
 
-    class RBTNode : public ParentNodeClass {
-    friend class TRedBlackTree;
-    protected:
-        RBTNode(const Value& _v) : 
-            ParentNodeClass(_v),
-            red(true)
-        {
+    // number of values in [lo, hi)
+    int count_range(const Value& lo, const Value& hi) const
+    {
+        return lo > hi ? 0 : rank(hi) - rank(lo);
+    }
 
+    // Moves the values above v to greater, which must be empty, and keeps
+    // those below v; v itself is dropped. Returns whether v was there. The
+    // nodes move, so the allocators must compare equal. Cutting the tree is
+    // O(log^2 n), counting the values that moved O(greater.size()) unless
+    // the tree keeps order statistics.
+    bool split(const Value& v, TRedBlackTree& greater)
+    {
+        assert(greater.size() == 0);
+        assert(this->node_alloc == greater.node_alloc);
+        RBTNode* less = 0;
+        RBTNode* more = 0;
+        RBTNode* found = split_nodes(this->root, v, less, more);
+        if (found != 0) {
+            this->destroy_node(found);
         }
+        this->root = blacken(less);
+        greater.root = blacken(more);
+        greater.sz = OrderStatistics ? count_of(more) : count_nodes(more);
+        this->sz -= greater.sz + (found != 0 ? 1 : 0);
+        return found != 0;
+    }
 
-        bool red;
+    // Appends the values of greater, which must all be above those of this
+    // tree, in O(log^2 n). greater is left empty.
+    void join(TRedBlackTree&& greater)
+    {
+        int greater_sz = greater.size();
+        RBTNode* more = adopt(greater);
+        this->root = blacken(join_nodes(this->root, more));
+        this->sz += greater_sz;
+    }
 
-        inline RBTNode* left_node() { return reinterpret_cast<RBTNode*>(this->left); }
-        inline RBTNode* right_node() { return reinterpret_cast<RBTNode*>(this->right); }
-        inline RBTNode* parent_node() { return reinterpret_cast<RBTNode*>(this->parent); }
-    };
+    // Fork-join set operations after Blelloch, Ferizovic and Sun, "Just
+    // Join for Parallel Ordered Sets": one tree is split by the root of the
+    // other, the halves below and above the root are combined recursively,
+    // and the results are joined again. The two recursive calls run on two
+    // threads for the top log2(threads) levels. other is left empty; its
+    // nodes are reused if the allocators compare equal. The threads free
+    // nodes, so they are only used with a stateless allocator such as the
+    // default pool, never with an arena.
+    void unite(TRedBlackTree&& other, int threads = 1)
+    {
+        assert(&other != this);
+        int other_sz = other.size();
+        RBTNode* theirs = adopt(other);
+        int common = 0;
+        this->root = blacken(union_nodes(this->root, theirs, fork_levels(threads), common));
+        this->sz += other_sz - common;
+    }
 
-protected:
-    virtual ParentNodeClass* create_node(const Value& v)
+    void intersect(TRedBlackTree&& other, int threads = 1)
     {
-        return new RBTNode(v);
+        assert(&other != this);
+        RBTNode* theirs = adopt(other);
+        int common = 0;
+        this->root = blacken(intersect_nodes(this->root, theirs, fork_levels(threads), common));
+        this->sz = common;
     }
 
-    virtual void internal_clear(ParentNodeClass** _r)
+    void subtract(TRedBlackTree&& other, int threads = 1)
     {
-        RBTNode** r = reinterpret_cast<RBTNode**>(_r);
-        if(*r != 0) {
-            internal_clear(&(*r)->left);
-            internal_clear(&(*r)->right);
-            delete *r;
-            *r = 0;
-        }
-        this->sz = 0;
+        assert(&other != this);
+        RBTNode* theirs = adopt(other);
+        int common = 0;
+        this->root = blacken(subtract_nodes(this->root, theirs, fork_levels(threads), common));
+        this->sz -= common;
     }
 
-    inline RBTNode* node_cast(ParentNodeClass* n)
+protected:
+    typedef TRedBlackTreeNode<Value, OrderStatistics> RBTNode;
+
+    void on_insert(RBTNode* n)
     {
-        return reinterpret_cast<RBTNode*>(n);
+        add_count_upwards(n->parent(), 1);
+        fix_insert(n, this->root);
     }
 
-    virtual void on_insert(ParentNodeClass* _n)
+    // n is red and may have a red parent; root is that of the tree n is in
+    void fix_insert(RBTNode* n, RBTNode*& root)
     {
-        RBTNode* n = node_cast(_n);
-        if (n == node_cast(this->root)) {
-            n->red = false;
+        if (n == root) {
+            n->set_red(false);
             return;
         }
-        RBTNode* p = n->parent_node();
-        if (!p->red) {
+        RBTNode* p = n->parent();
+        if (!p->is_red()) {
             return;
         }
-        RBTNode* gp = p->parent_node();
-        RBTNode* u = (p == gp->left_node()) ? gp->right_node() : gp->left_node();
+        RBTNode* gp = p->parent();
+        RBTNode* u = (p == gp->left) ? gp->right : gp->left;
         // u might be zero
-        if (p->red && u != 0 && u->red) {
-            p->red = u->red = false;
-            gp->red = true;
-            on_insert(gp);
+        if (p->is_red() && u != 0 && u->is_red()) {
+            p->set_red(false);
+            u->set_red(false);
+            gp->set_red(true);
+            fix_insert(gp, root);
             return;
         }
         bool rot = false;
-        if (n == p->right_node() && p == gp->left_node()) {
+        if (n == p->right && p == gp->left) {
             rot = true;
-            rotate_left(n, p, gp);
-        } else if (n == p->left_node() && p == gp->right_node()) {
+            rotate_left(n, p, gp, root);
+        } else if (n == p->left && p == gp->right) {
             rot = true;
-            rotate_right(n, p, gp);
+            rotate_right(n, p, gp, root);
         }
         if ( rot ) {
             std::swap(n, p);
         }
-        p->red = false;
-        gp->red = true;
-        RBTNode* ggp = gp->parent_node();
-        if (n == p->left_node()) {
-            rotate_right(p, gp, ggp);
-        } else if (n == p->right_node()) {
-            rotate_left(p, gp, ggp);
+        p->set_red(false);
+        gp->set_red(true);
+        RBTNode* ggp = gp->parent();
+        if (n == p->left) {
+            rotate_right(p, gp, ggp, root);
+        } else if (n == p->right) {
+            rotate_left(p, gp, ggp, root);
         }
     }
 
-    virtual void internal_remove(ParentNodeClass** _n)
+    // all black but the incomplete last level, which is red: every path
+    // then has the same number of black nodes, and no red node a red child
+    void on_build(RBTNode* n, bool bottom)
+    {
+        n->set_red(bottom);
+        update_count(n);
+    }
+
+    void internal_remove(RBTNode** n)
     {
-        RBTNode** n = reinterpret_cast<RBTNode**>(_n);
         if ((*n)->left == 0 || (*n)->right == 0) {
             delete_one_child(n);
         } else {
-            RBTNode** m = reinterpret_cast<RBTNode**>(this->leftmost_descendant(&(*n)->right));
+            RBTNode** m = this->leftmost_descendant(&(*n)->right);
             (*n)->v = (*m)->v;
             delete_one_child(m);
         }
@@ -177,130 +359,443 @@ private:
         if (n == 0) {
             return true;
         }
-        if (n->red) {
-            if (n->left != 0 && n->left_node()->red) {
+        if (n->is_red()) {
+            if (n->left != 0 && n->left->is_red()) {
                 return false;
-            } else if (n->right != 0 && n->right_node()->red) {
+            } else if (n->right != 0 && n->right->is_red()) {
                 return false;
             }
         }
+        if ((n->left != 0 && n->left->parent() != n) || (n->right != 0 && n->right->parent() != n)) {
+            return false;
+        }
+        if (OrderStatistics && n->subtree_count() != 1 + count_of(n->left) + count_of(n->right)) {
+            return false;
+        }
         int bn_left = 0, bn_right = 0;
-        bool sat_left = rbt_satisfied(n->left_node(), bn_left);
-        bool sat_right = rbt_satisfied(n->right_node(), bn_right);
+        bool sat_left = rbt_satisfied(n->left, bn_left);
+        bool sat_right = rbt_satisfied(n->right, bn_right);
         if(bn_left != bn_right) {
             return false;
         }
-        bn_path = bn_left + ((!n->red) ? 1 : 0);
+        bn_path = bn_left + ((!n->is_red()) ? 1 : 0);
         return sat_left && sat_right;
     }
 
+    // the nodes of other, allocated from the allocator of this tree
+    RBTNode* adopt(TRedBlackTree& other)
+    {
+        RBTNode* nodes = 0;
+        if (this->node_alloc == other.node_alloc) {
+            std::swap(nodes, other.root);
+            other.sz = 0;
+        } else {
+            nodes = this->build_sorted(other.begin_inorder(), other.size());
+            other.clear();
+        }
+        return nodes;
+    }
+
+    int fork_levels(int threads) const
+    {
+        if (!std::is_empty<typename ParentClass::NodeAlloc>::value) {
+            return 0;
+        }
+        int levels = 0;
+        while ((1 << levels) < threads) {
+            ++levels;
+        }
+        return levels;
+    }
+
+    // runs left() and right(), on two threads while forks are left
+    template<class Left, class Right>
+    static void fork_join(int forks, Left left, Right right)
+    {
+        if (forks > 0) {
+            std::thread thread(left);
+            right();
+            thread.join();
+        } else {
+            left();
+            right();
+        }
+    }
+
+    static RBTNode* detach(RBTNode* n)
+    {
+        if (n != 0) {
+            n->set_parent(0);
+        }
+        return n;
+    }
+
+    static void link(RBTNode* n, RBTNode* left, RBTNode* right)
+    {
+        n->left = left;
+        n->right = right;
+        if (left != 0) {
+            left->set_parent(n);
+        }
+        if (right != 0) {
+            right->set_parent(n);
+        }
+    }
+
+    // A detached subtree may have a red root, which a tree root must not
+    // have; making it black raises its black height evenly.
+    static RBTNode* blacken(RBTNode* n)
+    {
+        if (n != 0) {
+            n->set_red(false);
+        }
+        return n;
+    }
+
+    // black nodes from n down to a leaf, n included
+    static int black_height(RBTNode* n)
+    {
+        int h = 0;
+        for (; n != 0; n = n->left) {
+            h += n->is_red() ? 0 : 1;
+        }
+        return h;
+    }
+
+    // the order statistics; without them count_of is 0 and the updates do nothing
+    static int count_of(RBTNode* n)
+    {
+        return n != 0 ? n->subtree_count() : 0;
+    }
+
+    static void update_count(RBTNode* n)
+    {
+        if (OrderStatistics) {
+            n->set_subtree_count(1 + count_of(n->left) + count_of(n->right));
+        }
+    }
+
+    static void add_count_upwards(RBTNode* n, int delta)
+    {
+        if (OrderStatistics) {
+            for (; n != 0; n = n->parent()) {
+                n->set_subtree_count(n->subtree_count() + delta);
+            }
+        }
+    }
+
+    static int count_nodes(RBTNode* n)
+    {
+        int count = 0;
+        ParentClass::for_each_post_order(n, [&count] (RBTNode*) { ++count; } );
+        return count;
+    }
+
+    void destroy_subtree(RBTNode* n)
+    {
+        ParentClass::for_each_post_order(n, [this] (RBTNode* m) { this->destroy_node(m); } );
+    }
+
+    // The values of l are below that of the single node m, those of r above
+    // it. If l and r have the same black height m becomes their black
+    // root; otherwise m goes red down the spine of the higher tree next to
+    // a black node of the lower tree's height, and is fixed up as after an
+    // insert.
+    RBTNode* join_nodes(RBTNode* l, RBTNode* m, RBTNode* r)
+    {
+        if (l != 0) {
+            l->set_red(false);
+        }
+        if (r != 0) {
+            r->set_red(false);
+        }
+        int hl = black_height(l), hr = black_height(r);
+        m->set_parent(0);
+        if (hl == hr) {
+            link(m, l, r);
+            update_count(m);
+            m->set_red(false);
+            return m;
+        }
+        RBTNode* root = hl > hr ? l : r;
+        RBTNode* parent = 0;
+        RBTNode* c = root;
+        if (hl > hr) {
+            for (int h = hl; c != 0 && (c->is_red() || h > hr); c = c->right) {
+                h -= c->is_red() ? 0 : 1;
+                parent = c;
+            }
+            parent->right = m;
+            link(m, c, r);
+        } else {
+            for (int h = hr; c != 0 && (c->is_red() || h > hl); c = c->left) {
+                h -= c->is_red() ? 0 : 1;
+                parent = c;
+            }
+            parent->left = m;
+            link(m, l, c);
+        }
+        update_count(m);
+        m->set_parent(parent);
+        add_count_upwards(parent, m->subtree_count() - count_of(hl > hr ? m->left : m->right));
+        m->set_red(true);
+        fix_insert(m, root);
+        return root;
+    }
+
+    // all values of l below those of r
+    RBTNode* join_nodes(RBTNode* l, RBTNode* r)
+    {
+        if (l == 0) {
+            return r;
+        }
+        if (r == 0) {
+            return l;
+        }
+        RBTNode* last = 0;
+        l = split_last(l, last);
+        return join_nodes(l, last, r);
+    }
+
+    // t without its greatest node, which is detached and returned in last
+    RBTNode* split_last(RBTNode* t, RBTNode*& last)
+    {
+        RBTNode* l = detach(t->left);
+        RBTNode* r = detach(t->right);
+        if (r == 0) {
+            t->left = 0;
+            last = t;
+            return l;
+        }
+        return join_nodes(l, t, split_last(r, last));
+    }
+
+    // Cuts t into less, the values below v, and more, those above. Returns
+    // the detached node holding v, 0 if there is none.
+    RBTNode* split_nodes(RBTNode* t, const Value& v, RBTNode*& less, RBTNode*& more)
+    {
+        if (t == 0) {
+            less = more = 0;
+            return 0;
+        }
+        RBTNode* l = detach(t->left);
+        RBTNode* r = detach(t->right);
+        t->left = t->right = 0;
+        if (t->v == v) {
+            less = blacken(l);
+            more = blacken(r);
+            return t;
+        }
+        RBTNode* found = 0;
+        if (t->v > v) {
+            found = split_nodes(l, v, less, more);
+            more = join_nodes(more, t, r);
+        } else {
+            found = split_nodes(r, v, less, more);
+            less = join_nodes(l, t, less);
+        }
+        return found;
+    }
+
+    RBTNode* union_nodes(RBTNode* t1, RBTNode* t2, int forks, int& common)
+    {
+        if (t1 == 0) {
+            return t2;
+        }
+        if (t2 == 0) {
+            return t1;
+        }
+        RBTNode* l2 = 0;
+        RBTNode* r2 = 0;
+        RBTNode* found = split_nodes(t2, t1->v, l2, r2);
+        if (found != 0) {
+            this->destroy_node(found);
+            ++common;
+        }
+        RBTNode* l1 = detach(t1->left);
+        RBTNode* r1 = detach(t1->right);
+        RBTNode* l = 0;
+        RBTNode* r = 0;
+        int common_left = 0, common_right = 0;
+        fork_join(forks,
+            [&] () { l = this->union_nodes(l1, l2, forks - 1, common_left); },
+            [&] () { r = this->union_nodes(r1, r2, forks - 1, common_right); });
+        common += common_left + common_right;
+        return join_nodes(l, t1, r);
+    }
+
+    RBTNode* intersect_nodes(RBTNode* t1, RBTNode* t2, int forks, int& common)
+    {
+        if (t1 == 0 || t2 == 0) {
+            destroy_subtree(t1);
+            destroy_subtree(t2);
+            return 0;
+        }
+        RBTNode* l2 = 0;
+        RBTNode* r2 = 0;
+        RBTNode* found = split_nodes(t2, t1->v, l2, r2);
+        RBTNode* l1 = detach(t1->left);
+        RBTNode* r1 = detach(t1->right);
+        RBTNode* l = 0;
+        RBTNode* r = 0;
+        int common_left = 0, common_right = 0;
+        fork_join(forks,
+            [&] () { l = this->intersect_nodes(l1, l2, forks - 1, common_left); },
+            [&] () { r = this->intersect_nodes(r1, r2, forks - 1, common_right); });
+        common += common_left + common_right;
+        if (found != 0) {
+            this->destroy_node(found);
+            ++common;
+            return join_nodes(l, t1, r);
+        }
+        this->destroy_node(t1);
+        return join_nodes(l, r);
+    }
+
+    // removed counts the values of t1 that were also in t2
+    RBTNode* subtract_nodes(RBTNode* t1, RBTNode* t2, int forks, int& removed)
+    {
+        if (t1 == 0) {
+            destroy_subtree(t2);
+            return 0;
+        }
+        if (t2 == 0) {
+            return t1;
+        }
+        RBTNode* l1 = 0;
+        RBTNode* r1 = 0;
+        RBTNode* found = split_nodes(t1, t2->v, l1, r1);
+        if (found != 0) {
+            this->destroy_node(found);
+            ++removed;
+        }
+        RBTNode* l2 = detach(t2->left);
+        RBTNode* r2 = detach(t2->right);
+        this->destroy_node(t2);
+        RBTNode* l = 0;
+        RBTNode* r = 0;
+        int removed_left = 0, removed_right = 0;
+        fork_join(forks,
+            [&] () { l = this->subtract_nodes(l1, l2, forks - 1, removed_left); },
+            [&] () { r = this->subtract_nodes(r1, r2, forks - 1, removed_right); });
+        removed += removed_left + removed_right;
+        return join_nodes(l, r);
+    }
+
     inline void delete_one_child(RBTNode** n)
     {
-        RBTNode* child = ((*n)->left == 0) ? (*n)->right_node() : (*n)->left_node();
+        RBTNode* child = ((*n)->left == 0) ? (*n)->right : (*n)->left;
+        // the counts leave *n out from here on, also in the rotations below
+        add_count_upwards((*n)->parent(), -1);
+        (*n)->set_subtree_count(count_of(child));
 
-        if (!(*n)->red) {
-            if (child != 0 && child->red) {
-                child->red = false;
+        if (!(*n)->is_red()) {
+            if (child != 0 && child->is_red()) {
+                child->set_red(false);
             } else {
                 delete_cases(*n);
             }
         }
         if(child != 0) {
-            child->parent = (*n)->parent_node();
+            child->set_parent((*n)->parent());
         }
         RBTNode* tmp = *n;
         *n = child;
-        delete tmp;
+        this->destroy_node(tmp);
     }
 
     inline void delete_cases(RBTNode* n) 
     {
-        if(n->parent == 0) {
+        if(n->parent() == 0) {
             return;
         }
-        RBTNode* p = n->parent_node();
-        RBTNode* s = (n == p->left_node()) ? p->right_node() : p->left_node();
-        if(s != 0 && s->red) {
-            p->red = true;
-            s->red = false;
-            if (s == p->left_node()) {
-                rotate_right(s, p, p->parent_node());
-                s = p->left_node();
+        RBTNode* p = n->parent();
+        RBTNode* s = (n == p->left) ? p->right : p->left;
+        if(s != 0 && s->is_red()) {
+            p->set_red(true);
+            s->set_red(false);
+            if (s == p->left) {
+                rotate_right(s, p, p->parent(), this->root);
+                s = p->left;
             } else {
-                rotate_left(s, p, p->parent_node());
-                s = p->right_node();
+                rotate_left(s, p, p->parent(), this->root);
+                s = p->right;
             }
         }
-        if (!p->red && !s->red && (s->left == 0 || !s->left_node()->red) && (s->right == 0 || !s->right_node()->red)) {
-            s->red = true;
+        if (!p->is_red() && !s->is_red() && (s->left == 0 || !s->left->is_red()) && (s->right == 0 || !s->right->is_red())) {
+            s->set_red(true);
             delete_cases(p);
             return;
         }
-        if (p->red && !s->red && (s->left == 0 || !s->left_node()->red) && (s->right == 0 || !s->right_node()->red)) {
-            s->red = true;
-            p->red = false;
+        if (p->is_red() && !s->is_red() && (s->left == 0 || !s->left->is_red()) && (s->right == 0 || !s->right->is_red())) {
+            s->set_red(true);
+            p->set_red(false);
             return;
         }
-        if (!s->red) {
-            if (n == p->left_node() && (s->right == 0 || !s->right_node()->red) && s->left != 0 && s->left_node()->red) {
-                s->red = true;
-                RBTNode* sl = s->left_node();
-                sl->red = false;
-                rotate_right(sl, s, s->parent_node());
+        if (!s->is_red()) {
+            if (n == p->left && (s->right == 0 || !s->right->is_red()) && s->left != 0 && s->left->is_red()) {
+                s->set_red(true);
+                RBTNode* sl = s->left;
+                sl->set_red(false);
+                rotate_right(sl, s, s->parent(), this->root);
                 std::swap(sl, s);
-            } else if (n == p->right_node() && (s->left == 0 || !s->left_node()->red) && s->right != 0 && s->right_node()->red) {
-                s->red = true;
-                RBTNode* sr = s->right_node();
-                sr->red = false;
-                rotate_left(sr, s, s->parent_node());
+            } else if (n == p->right && (s->left == 0 || !s->left->is_red()) && s->right != 0 && s->right->is_red()) {
+                s->set_red(true);
+                RBTNode* sr = s->right;
+                sr->set_red(false);
+                rotate_left(sr, s, s->parent(), this->root);
                 std::swap(sr, s);
             }
         }
-        s->red = p->red;
-        p->red = false;
-        if (n == p->left_node()) {
-            s->right_node()->red = false;
-            rotate_left(s, p, p->parent_node());
+        s->set_red(p->is_red());
+        p->set_red(false);
+        if (n == p->left) {
+            s->right->set_red(false);
+            rotate_left(s, p, p->parent(), this->root);
         } else {
-            s->left_node()->red = false;
-            rotate_right(s, p, p->parent_node());
+            s->left->set_red(false);
+            rotate_right(s, p, p->parent(), this->root);
         }
     }
 
-    inline void rotate_left(RBTNode* n, RBTNode* p, RBTNode* gp) {
-        RBTNode* tmp_left_n = n->left_node();
+    inline void rotate_left(RBTNode* n, RBTNode* p, RBTNode* gp, RBTNode*& root) {
+        RBTNode* tmp_left_n = n->left;
         if (gp != 0) {
-            if (p == gp->left_node()) {
+            if (p == gp->left) {
                 gp->left = n;
             } else {
                 gp->right = n;
             }
-            n->parent = gp;
+            n->set_parent(gp);
         } else {
-            this->root = n;
-            n->parent = 0;            
+            root = n;
+            n->set_parent(0);            
         }
-        n->left = p; p->parent = n;
+        n->left = p; p->set_parent(n);
         p->right = tmp_left_n; 
-        if (tmp_left_n != 0) tmp_left_n->parent = p;
+        if (tmp_left_n != 0) tmp_left_n->set_parent(p);
+        update_count(p);
+        update_count(n);
     }
 
-    inline void rotate_right(RBTNode* n, RBTNode* p, RBTNode* gp) {
-        RBTNode* tmp_right_n = n->right_node();
+    inline void rotate_right(RBTNode* n, RBTNode* p, RBTNode* gp, RBTNode*& root) {
+        RBTNode* tmp_right_n = n->right;
         if(gp != 0) {
-            if (p == gp->left_node()) {
+            if (p == gp->left) {
                 gp->left = n;
             } else {
                 gp->right = n;
             }
-            n->parent = gp;
+            n->set_parent(gp);
         } else {
-            this->root = n;
-            n->parent = 0;            
+            root = n;
+            n->set_parent(0);            
         }
-        n->right = p; p->parent = n;
+        n->right = p; p->set_parent(n);
         p->left = tmp_right_n; 
-        if (tmp_right_n != 0) tmp_right_n->parent = p;
+        if (tmp_right_n != 0) tmp_right_n->set_parent(p);
+        update_count(p);
+        update_count(n);
     }
 
 };
\ No newline at end of file
@@ -1,9 +1,14 @@
+#include <algorithm>
 #include <assert.h>
 #include <cstdlib>
 #include <cmath>
+#include <malloc.h>
+#include <string>
 #include <binary_tree.h>
 #include <redblack_tree.h>
+#include <bplus_tree.h>
 #include <measure.h>
+#include <single_list.h>
 #include <debug_new.h>
 
 void test_basic()
@@ -42,6 +47,41 @@ void test_ascending()
     }
 }
 
+// bytes the heap holds, with what malloc adds to each block
+size_t heap_bytes()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// a list-shaped tree is walked without recursion and without allocating
+void test_degenerate_traversal()
+{
+    TBinaryTree<int> tree;
+    const int N = 20000;
+    for (int i = N; i > 0; i--) {
+        tree.insert(i);
+    }
+    size_t before = heap_bytes();
+    assert(tree.depth() == N);
+    long long in_sum = 0, pre_sum = 0, post_sum = 0;
+    int expected = 0;
+    bool ascending = true;
+    tree.in_order_traverse( [&] (int v) { ascending = ascending && v == ++expected; in_sum += v; } );
+    tree.pre_order_traverse( [&pre_sum] (int v) { pre_sum += v; } );
+    tree.post_order_traverse( [&post_sum] (int v) { post_sum += v; } );
+    assert(heap_bytes() == before);
+    assert(ascending && expected == N);
+    assert(in_sum == (long long)N * (N + 1) / 2 && pre_sum == in_sum && post_sum == in_sum);
+    tree.insert(N + 2);
+    tree.insert(N + 1);
+    assert(tree.depth() == N);
+    tree.insert(0);
+    assert(tree.depth() == N + 1);
+    tree.clear();
+    assert(tree.depth() == 0);
+}
+
 void test_worst_case_ins_depth()
 {
     TBinaryTree<int> tree;
@@ -230,6 +270,308 @@ void test_iterator()
     assert(std::equal(tree.begin_postorder(), tree.end_postorder(), postorder_list.begin()));
 }
 
+template <class Tree>
+void test_string_values()
+{
+    Tree tree;
+    for (int i = 0; i < 1000; i++) {
+        assert(tree.insert(std::to_string(i * 7 % 1000)));
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        assert(tree.remove(std::to_string(i)));
+    }
+    assert(tree.size() == 500);
+    assert(tree.find("1"));
+    assert(!tree.find("2"));
+    Tree copy(tree);
+    tree.clear();
+    assert(tree.size() == 0);
+    assert(tree.insert("x"));
+    assert(copy.size() == 500);
+    assert(std::is_sorted(copy.begin_inorder(), copy.end_inorder()));
+}
+
+void test_allocators()
+{
+    test_move_copy<TBinaryTree<int, std::allocator<int>>>();
+    test_move_copy<TBinaryTree<int, TArenaAllocator<int>>>();
+    test_move_copy<TRedBlackTree<int, std::allocator<int>>>();
+    test_move_copy<TRedBlackTree<int, TArenaAllocator<int>>>();
+    test_iterator<TRedBlackTree<int, TArenaAllocator<int>>>();
+    test_string_values<TBinaryTree<std::string>>();
+    test_string_values<TRedBlackTree<std::string>>();
+    test_string_values<TRedBlackTree<std::string, TArenaAllocator<std::string>>>();
+}
+
+// small nodes, so that splits, borrows and merges happen on every level
+template <class Tree>
+void test_bplus_tree_against_rbtree()
+{
+    Tree tree;
+    TRedBlackTree<int> reference;
+    for (int i = 0; i < 20000; i++) {
+        int v = rand() % 2000;
+        if (rand() % 3 == 0) {
+            assert(tree.remove(v) == reference.remove(v));
+        } else {
+            assert(tree.insert(v) == reference.insert(v));
+        }
+        if (i % 1000 == 0) {
+            assert(tree.bplus_satisfied());
+        }
+    }
+    assert(tree.bplus_satisfied());
+    assert(tree.size() == reference.size());
+    assert(std::equal(tree.begin_inorder(), tree.end_inorder(), reference.begin_inorder()));
+    for (int v = 0; v < 2000; v++) {
+        assert(tree.find(v) == reference.find(v));
+    }
+
+    Tree copy(tree);
+    assert(copy.bplus_satisfied());
+    assert(std::equal(copy.begin_inorder(), copy.end_inorder(), reference.begin_inorder()));
+    for (int v = 0; v < 2000; v++) {
+        tree.remove(v);
+    }
+    assert(tree.size() == 0);
+    assert(tree.depth() == 0);
+    assert(tree.begin_inorder() == tree.end_inorder());
+    assert(copy.size() == reference.size());
+}
+
+void test_bplus_tree()
+{
+    TBPlusTree<int> tree;
+    assert(tree.depth() == 0);
+    for (int i = 0; i < 100000; i++) {
+        assert(tree.insert(i));
+    }
+    assert(tree.bplus_satisfied());
+    assert(tree.depth() <= 5);
+    assert(!tree.insert(500));
+    assert(std::is_sorted(tree.begin_inorder(), tree.end_inorder()));
+
+    test_bplus_tree_against_rbtree<TBPlusTree<int, TPoolAllocator<int>, 3, 3>>();
+    test_bplus_tree_against_rbtree<TBPlusTree<int, TPoolAllocator<int>, 4, 5>>();
+    test_bplus_tree_against_rbtree<TBPlusTree<int, TArenaAllocator<int>, 5, 4>>();
+    test_move_copy<TBPlusTree<int>>();
+    test_move_copy<TBPlusTree<int, TArenaAllocator<int>>>();
+    test_string_values<TBPlusTree<std::string>>();
+    test_string_values<TBPlusTree<std::string, TArenaAllocator<std::string>, 3, 3>>();
+}
+
+template <class Tree>
+void build_sorted_tree(Tree& tree, int n)
+{
+    TSingleLinkedList<int> values;
+    for (int i = 0; i < n; i++) {
+        values.push_back(2 * i);
+    }
+    tree.assign_sorted(values.begin(), values.end());
+    assert(tree.size() == n);
+    assert(std::equal(tree.begin_inorder(), tree.end_inorder(), values.begin()));
+}
+
+void test_assign_sorted()
+{
+    for (int n = 0; n < 300; n++) {
+        TRedBlackTree<int> rbtree;
+        rbtree.insert(-1);
+        build_sorted_tree(rbtree, n);
+        assert(rbtree.rbt_satisfied());
+        assert(rbtree.depth() == int(ceil(log2(n + 1))));
+        assert(!rbtree.find(-1));
+        for (int i = 0; i < n; i++) {
+            assert(rbtree.insert(2 * i + 1));
+            assert(rbtree.remove(2 * i));
+        }
+        assert(rbtree.rbt_satisfied());
+
+        TBinaryTree<int> tree;
+        build_sorted_tree(tree, n);
+        assert(tree.depth() == int(ceil(log2(n + 1))));
+
+        TBPlusTree<int, TPoolAllocator<int>, 3, 4> bptree;
+        build_sorted_tree(bptree, n);
+        assert(bptree.bplus_satisfied());
+        for (int i = 0; i < n; i++) {
+            assert(bptree.insert(2 * i + 1));
+            assert(bptree.remove(2 * i));
+        }
+        assert(bptree.bplus_satisfied());
+    }
+
+    TRedBlackTree<std::string, TArenaAllocator<std::string>> strings;
+    strings.insert("b");
+    strings.insert("a");
+    TRedBlackTree<std::string, TArenaAllocator<std::string>> copy(strings);
+    assert(copy.size() == 2);
+    assert(copy.rbt_satisfied());
+    assert(*copy.begin_inorder() == "a");
+}
+
+template <class Tree>
+void random_tree(Tree& tree, int n, int range)
+{
+    for (int i = 0; i < n; i++) {
+        tree.insert(rand() % range);
+    }
+}
+
+// A tree left by split, join or a set operation must be valid and take
+// further updates; a red root, say, breaks the next insert.
+template <class Tree>
+void check_updatable(Tree& tree, int v)
+{
+    assert(tree.rbt_satisfied());
+    int size = tree.size();
+    bool had = tree.find(v);
+    assert(tree.insert(v) == !had);
+    assert(tree.rbt_satisfied());
+    if (!had) {
+        assert(tree.remove(v));
+    }
+    assert(tree.size() == size);
+    assert(tree.rbt_satisfied());
+}
+
+template <class Tree>
+void test_split_join()
+{
+    {
+        // the children of the root become the roots
+        Tree tree, greater;
+        tree.insert(0);
+        tree.insert(1);
+        assert(tree.split(0, greater));
+        check_updatable(tree, 2);
+        check_updatable(greater, 2);
+    }
+    for (int n = 0; n < 2000; n += 97) {
+        Tree tree;
+        random_tree(tree, n, 1000);
+        Tree copy(tree);
+        for (int v = -1; v <= 1000; v += 77) {
+            Tree less(copy), greater;
+            bool had = less.find(v);
+            assert(less.split(v, greater) == had);
+            check_updatable(less, rand() % 1000);
+            check_updatable(greater, rand() % 1000);
+            assert(less.size() + greater.size() + (had ? 1 : 0) == copy.size());
+            assert(less.size() == 0 || *less.begin_inorder() == *copy.begin_inorder());
+            less.in_order_traverse( [v] (int x) { assert(x < v); } );
+            greater.in_order_traverse( [v] (int x) { assert(x > v); } );
+            if (had) {
+                assert(less.insert(v));
+            }
+            less.join(std::move(greater));
+            assert(greater.size() == 0);
+            check_updatable(less, rand() % 1000);
+            assert(less.size() == copy.size());
+            assert(std::equal(less.begin_inorder(), less.end_inorder(), copy.begin_inorder()));
+        }
+    }
+}
+
+template <class Tree>
+void test_join_set_ops(int threads)
+{
+    for (int n1 = 0; n1 < 3000; n1 += 701) {
+        for (int n2 = 0; n2 < 3000; n2 += 901) {
+            Tree tree1, tree2;
+            random_tree(tree1, n1, 4000);
+            random_tree(tree2, n2, 4000);
+            Tree united(tree1), intersected(tree1), subtracted(tree1);
+            Tree copy(tree2);
+            united.unite(std::move(copy), threads);
+            assert(copy.size() == 0);
+            copy = tree2;
+            intersected.intersect(std::move(copy), threads);
+            copy = tree2;
+            subtracted.subtract(std::move(copy), threads);
+            check_updatable(united, rand() % 4000);
+            check_updatable(intersected, rand() % 4000);
+            check_updatable(subtracted, rand() % 4000);
+            int n_united = 0, n_intersected = 0, n_subtracted = 0;
+            for (int v = 0; v < 4000; v++) {
+                bool in1 = tree1.find(v), in2 = tree2.find(v);
+                assert(united.find(v) == (in1 || in2));
+                assert(intersected.find(v) == (in1 && in2));
+                assert(subtracted.find(v) == (in1 && !in2));
+                n_united += (in1 || in2) ? 1 : 0;
+                n_intersected += (in1 && in2) ? 1 : 0;
+                n_subtracted += (in1 && !in2) ? 1 : 0;
+            }
+            assert(united.size() == n_united);
+            assert(intersected.size() == n_intersected);
+            assert(subtracted.size() == n_subtracted);
+        }
+    }
+}
+
+void test_order_statistics()
+{
+    typedef TRedBlackTree<int, TPoolAllocator<int>, true> Tree;
+    Tree tree;
+    for (int i = 0; i < 20000; i++) {
+        int v = rand() % 5000;
+        if (rand() % 3 == 0) {
+            tree.remove(v);
+        } else {
+            tree.insert(v);
+        }
+    }
+    assert(tree.rbt_satisfied());
+    int k = 0;
+    for (auto it = tree.begin_inorder(); it != tree.end_inorder(); ++it, ++k) {
+        assert(tree.select(k) == *it);
+        assert(tree.rank(*it) == k);
+        assert(tree.rank(*it + 1) == k + 1);
+    }
+    assert(k == tree.size());
+    assert(tree.rank(-1) == 0);
+    assert(tree.rank(5000) == tree.size());
+    assert(tree.count_range(0, 5000) == tree.size());
+    assert(tree.count_range(100, 100) == 0);
+    assert(tree.count_range(200, 100) == 0);
+    int in_range = 0;
+    tree.in_order_traverse( [&in_range] (int v) { in_range += (v >= 1000 && v < 2500) ? 1 : 0; } );
+    assert(tree.count_range(1000, 2500) == in_range);
+
+    Tree copy(tree);
+    assert(copy.rbt_satisfied());
+    assert(copy.select(copy.size() / 2) == tree.select(tree.size() / 2));
+
+    test_split_join<Tree>();
+    test_join_set_ops<Tree>(4);
+}
+
+template <class Tree>
+void test_bounds()
+{
+    Tree tree;
+    assert(tree.lower_bound(1) == tree.end_inorder());
+    assert(tree.upper_bound(1) == tree.end_inorder());
+    for (int i = 0; i < 2000; i++) {
+        tree.insert(2 * (rand() % 1000));
+    }
+    for (int v = -1; v <= 2001; v++) {
+        auto lower = tree.begin_inorder();
+        while (lower != tree.end_inorder() && *lower < v) {
+            ++lower;
+        }
+        auto upper = lower;
+        if (upper != tree.end_inorder() && *upper == v) {
+            ++upper;
+        }
+        assert(tree.lower_bound(v) == lower);
+        assert(tree.upper_bound(v) == upper);
+        auto range = tree.equal_range(v);
+        assert(range.first == lower && range.second == upper);
+        assert((std::distance(range.first, range.second) == 1) == tree.find(v));
+    }
+}
+
 void test_inorder_sorted()
 {
     TRedBlackTree<int> rbtree;
@@ -250,6 +592,61 @@ void copy_tree_iterator(Iterator begin, Iterator end, TRedBlackTree<int>& to)
     }
 }
 
+template<class Iterator>
+void sum_tree_iterator(Iterator begin, Iterator end, long long& sum)
+{
+    for (; begin != end; ++begin) {
+        sum += *begin;
+    }
+}
+
+template<class Iterator>
+void measure_tree_iterator(const char* name, Iterator begin, Iterator end, int size, int times)
+{
+    long long sum = 0;
+    std::cout << "Iterating over " << size << " items with " << name << " iterator " << times << " times takes " << Nstd::measure<>::execution(
+        [&] () { for (int i = 0; i < times; ++i) sum_tree_iterator(begin, end, sum); }
+    ) << "us" << std::endl;
+    assert(sum != 1);
+}
+
+// a tree small enough to stay in cache, so that the cost of ++it shows
+void measure_iteration()
+{
+    TRedBlackTree<int> rbtree;
+    for(int i = 0; i < 10000; i++) {
+        rbtree.insert(rand() % 100000);
+    }
+    measure_tree_iterator("preorder", rbtree.begin_preorder(), rbtree.end_preorder(), rbtree.size(), 1000);
+    measure_tree_iterator("inorder", rbtree.begin_inorder(), rbtree.end_inorder(), rbtree.size(), 1000);
+    measure_tree_iterator("postorder", rbtree.begin_postorder(), rbtree.end_postorder(), rbtree.size(), 1000);
+}
+
+// The nodes come from an arena of the tree's own, so the heap bytes per
+// element are the node size plus the slack at the slab ends.
+template<class Tree>
+void report_footprint(const char* name)
+{
+    const int N = 1000000;
+    size_t before = heap_bytes();
+    Tree tree;
+    for (int i = 0; i < N; i++) {
+        tree.insert(rand());
+    }
+    double per_element = double(heap_bytes() - before) / tree.size();
+    std::cout << name << ": node " << Tree::node_size() << " bytes, " << per_element << " heap bytes per element" << std::endl;
+}
+
+void measure_footprint()
+{
+    report_footprint<TBinaryTree<int, TArenaAllocator<int>>>("TBinaryTree<int>");
+    report_footprint<TRedBlackTree<int, TArenaAllocator<int>>>("TRedBlackTree<int>");
+    report_footprint<TRedBlackTree<int, TArenaAllocator<int>, true>>("TRedBlackTree<int> with order statistics");
+    report_footprint<TBinaryTree<long long, TArenaAllocator<long long>>>("TBinaryTree<long long>");
+    report_footprint<TRedBlackTree<long long, TArenaAllocator<long long>>>("TRedBlackTree<long long>");
+    report_footprint<TRedBlackTree<long long, TArenaAllocator<long long>, true>>("TRedBlackTree<long long> with order statistics");
+}
+
 void test_rbtree_copy_order()
 {
     TRedBlackTree<int> rbtree;
@@ -259,6 +656,10 @@ void test_rbtree_copy_order()
         int v = rand() % 10000000;
         rbtree.insert(v);
     }
+
+    measure_tree_iterator("preorder", rbtree.begin_preorder(), rbtree.end_preorder(), rbtree.size(), 1);
+    measure_tree_iterator("inorder", rbtree.begin_inorder(), rbtree.end_inorder(), rbtree.size(), 1);
+    measure_tree_iterator("postorder", rbtree.begin_postorder(), rbtree.end_postorder(), rbtree.size(), 1);
     
     TRedBlackTree<int> tree1;
     std::cout << "Copying " << rbtree.size() << " items with preorder iterator takes " << Nstd::measure<>::execution(
@@ -286,6 +687,13 @@ void test_rbtree_copy_order()
         tree3
     ) << "us" << std::endl;
     assert(tree3.size() == rbtree.size());
+
+    TRedBlackTree<int> tree4;
+    std::cout << "Copying " << rbtree.size() << " items with operator= takes " << Nstd::measure<>::execution(
+        [&] () { tree4 = rbtree; }
+    ) << "us" << std::endl;
+    assert(tree4.size() == rbtree.size());
+    assert(tree4.rbt_satisfied());
 }
 
 void test_iterator_order()
@@ -333,6 +741,7 @@ int main(int argc, char* argv[])
 {
     test_basic();
     test_ascending();
+    test_degenerate_traversal();
     test_worst_case_ins_depth();
     test_ins_depth();
     test_in_order_traverse();
@@ -343,8 +752,22 @@ int main(int argc, char* argv[])
     test_move_copy<TRedBlackTree<int>>();
     test_iterator<TBinaryTree<int>>();
     test_iterator<TRedBlackTree<int>>();
+    test_allocators();
+    test_bplus_tree();
+    test_assign_sorted();
+    test_split_join<TRedBlackTree<int>>();
+    test_join_set_ops<TRedBlackTree<int>>(1);
+    test_join_set_ops<TRedBlackTree<int>>(4);
+    test_join_set_ops<TRedBlackTree<int, TArenaAllocator<int>>>(4);
+    test_order_statistics();
+    test_bounds<TBinaryTree<int>>();
+    test_bounds<TRedBlackTree<int>>();
+    test_bounds<TBPlusTree<int>>();
+    test_bounds<TBPlusTree<int, TPoolAllocator<int>, 3, 3>>();
     test_inorder_sorted();
     test_iterator_order();
+    measure_iteration();
+    measure_footprint();
     test_rbtree_copy_order();
     return 0;
 }